@@ -2,888 +2,3914 @@
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <future>
+#include <optional>
 #include <chrono>
-#include <iostream> // Pour afficher des erreurs ventuelles
+#include <iostream> // Pour afficher des erreurs éventuelles
 #include <random>
+#include <string>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <initializer_list>
+#include <array>
+#include <utility>
+#include <limits>
+#include <bit>
+#include <cstring>
+#include <charconv>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <filesystem>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 
 // Constantes globales
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
 
+// Échelle et vitesses réelles des usagers
+const float PIXELS_PER_METER = 10.0f; // Une voiture (40 px) mesure 4 m
+const float CAR_SPEED = 10.0f;        // m/s (36 km/h)
+const float BUS_SPEED = 7.5f;         // m/s
+const float BIKE_SPEED = 5.0f;        // m/s
+const float PEDESTRIAN_SPEED = 1.4f;  // m/s
 
-enum TrafficLightState { RedHorizontal, OrangeHorizontal, GreenHorizontal, RedHorizontalOrangeVertical };
-
-// Mutex pour synchronisation des threads
-std::mutex trafficMutex;
-
-// Classe Feu de circulation
-class TrafficLight {
-private:
-    TrafficLightState state;
-    sf::RectangleShape lightHorizontalLeft;
-    sf::RectangleShape lightHorizontalRight;
-    sf::RectangleShape lightVerticalTop;
-    sf::RectangleShape lightVerticalBottom;
-    sf::RectangleShape lightHorizontalExtra;
-    sf::RectangleShape lightVerticalExtra;
+// Dossier des images sources et paquet d'images prêt à l'emploi (chemins relatifs à la racine du projet)
+const std::string IMAGE_DIR = "Projet/img/";
+const std::string ASSET_PACK = "Projet/img/assets.pack";
 
-public:
-    TrafficLight() : state(RedHorizontal) {
-        // Feu pour les vhicules venant de gauche
-        lightHorizontalLeft.setSize(sf::Vector2f(20, 20));
-        lightHorizontalLeft.setPosition(180, 430);
-        lightHorizontalLeft.setFillColor(sf::Color::Red);
+// Les sprites sont stockés à deux fois leur taille affichée ; les mipmaps couvrent les réductions
+const unsigned SPRITE_SCALE = 2;
 
-        // Feu pour les vhicules venant de droite
-        lightHorizontalRight.setSize(sf::Vector2f(20, 20));
-        lightHorizontalRight.setPosition(600, 150);
-        lightHorizontalRight.setFillColor(sf::Color::Red);
+// Pas de temps fixe de la simulation (secondes), indépendant de la cadence d'affichage
+const float SIM_DT = 1.0f / 120.0f;
 
-        // Feu pour les vhicules venant du haut
-        lightVerticalTop.setSize(sf::Vector2f(20, 20));
-        lightVerticalTop.setPosition(220, 110);
-        lightVerticalTop.setFillColor(sf::Color::Green);
 
-        // Feu pour les vhicules venant du bas
-        lightVerticalBottom.setSize(sf::Vector2f(20, 20));
-        lightVerticalBottom.setPosition(560, 470);
-        lightVerticalBottom.setFillColor(sf::Color::Green);
+enum TrafficLightState { RedHorizontal, OrangeHorizontal, GreenHorizontal, RedHorizontalOrangeVertical };
 
+// Classe Feu de circulation : seulement l'état qui fait foi, publié de façon atomique.
+// Seule la simulation fait changer les feux (voir TimingWheel) ; les lecteurs ne bloquent jamais.
+class TrafficLight {
+private:
+    std::atomic<TrafficLightState> state;
 
-        lightHorizontalExtra.setSize(sf::Vector2f(20, 20));
-        lightHorizontalExtra.setPosition(75, 430);
-        lightHorizontalExtra.setFillColor(sf::Color::Red);
+public:
+    TrafficLight() : state(RedHorizontal) {}
 
-        lightVerticalExtra.setSize(sf::Vector2f(20, 20));
-        lightVerticalExtra.setPosition(560, 543);
-        lightVerticalExtra.setFillColor(sf::Color::Green);
-    }
+    // Copie de l'état courant (les carrefours sont rangés dans un vector)
+    TrafficLight(const TrafficLight& other) : state(other.getState()) {}
 
     void changeState() {
-        std::lock_guard<std::mutex> lock(trafficMutex);
-        switch (state) {
+        switch (state.load(std::memory_order_relaxed)) {
         case RedHorizontal:
-            state = GreenHorizontal;
-            lightHorizontalLeft.setFillColor(sf::Color::Green);
-            lightHorizontalRight.setFillColor(sf::Color::Green);
-            lightVerticalTop.setFillColor(sf::Color::Red);
-            lightVerticalBottom.setFillColor(sf::Color::Red);
-            lightHorizontalExtra.setFillColor(sf::Color::Green);
-            lightVerticalExtra.setFillColor(sf::Color::Red);
+            state.store(GreenHorizontal, std::memory_order_release);
             break;
         case GreenHorizontal:
-            state = OrangeHorizontal;
-            lightHorizontalLeft.setFillColor(sf::Color(255, 165, 0)); // Orange
-            lightHorizontalRight.setFillColor(sf::Color(255, 165, 0)); // Orange
-            lightVerticalTop.setFillColor(sf::Color::Red);
-            lightVerticalBottom.setFillColor(sf::Color::Red);
-            lightHorizontalExtra.setFillColor(sf::Color(255, 165, 0));
-            lightVerticalExtra.setFillColor(sf::Color::Red);
+            state.store(OrangeHorizontal, std::memory_order_release);
             break;
         case OrangeHorizontal:
-            state = RedHorizontalOrangeVertical;
-            lightHorizontalLeft.setFillColor(sf::Color::Red);
-            lightHorizontalRight.setFillColor(sf::Color::Red);
-            lightVerticalTop.setFillColor(sf::Color::Green);
-            lightVerticalBottom.setFillColor(sf::Color::Green);
-            lightHorizontalExtra.setFillColor(sf::Color::Red);
-            lightVerticalExtra.setFillColor(sf::Color::Green);
+            state.store(RedHorizontalOrangeVertical, std::memory_order_release);
             break;
         case RedHorizontalOrangeVertical:
-            state = RedHorizontal;
-            lightHorizontalLeft.setFillColor(sf::Color::Red);
-            lightHorizontalRight.setFillColor(sf::Color::Red);
-            lightVerticalTop.setFillColor(sf::Color(255, 165, 0)); // Orange
-            lightVerticalBottom.setFillColor(sf::Color(255, 165, 0)); // Orange
-            lightHorizontalExtra.setFillColor(sf::Color::Red);
-            lightVerticalExtra.setFillColor(sf::Color(255, 165, 0));
+            state.store(RedHorizontal, std::memory_order_release);
             break;
         }
     }
 
-    TrafficLightState getState() {
-        std::lock_guard<std::mutex> lock(trafficMutex);
-        return state;
+    TrafficLightState getState() const {
+        return state.load(std::memory_order_acquire);
     }
 
-    void draw(sf::RenderWindow& window) {
-        window.draw(lightHorizontalLeft);
-        window.draw(lightHorizontalRight);
-        window.draw(lightVerticalTop);
-        window.draw(lightVerticalBottom);
-        window.draw(lightHorizontalExtra);
-        window.draw(lightVerticalExtra);
+    // Remet le feu dans un état enregistré (rejeu)
+    void setState(TrafficLightState newState) {
+        state.store(newState, std::memory_order_release);
     }
 };
 
-
-// Classe pour les usagers (vhicules)
-class User {
+// Affichage des feux : les couleurs sont déduites de l'état au moment du dessin.
+// Les six feux sont des carrés d'un même sf::VertexArray, dessinés en un seul appel.
+class TrafficLightRenderer {
 private:
-    bool stopped = false;
-protected:
-    sf::Sprite sprite;
-    float speed;
-    bool isHorizontal;
-    bool goingPositive;
-    bool hasTurned;       // Indique si la voiture a dj tourn
-    bool turnLeftAtCenter; // Indique si cette voiture doit tourner  gauche au centre
-    bool turnRightAtCenter; // Indique si la voiture doit tourner  droite au centre
-    float currentSpeed;
+    static constexpr int LIGHT_COUNT = 6;
+    static constexpr float LIGHT_SIZE = 20;
+
+    sf::VertexArray lights;
+
+    // Coin haut gauche de chaque feu et axe qu'il règle
+    struct LightPlacement {
+        float x, y;
+        bool horizontal;
+    };
+    static constexpr LightPlacement placements[LIGHT_COUNT] = {
+        { 180, 430, true },     // Feu pour les véhicules venant de gauche
+        { 600, 150, true },     // Feu pour les véhicules venant de droite
+        { 220, 110, false },    // Feu pour les véhicules venant du haut
+        { 560, 470, false },    // Feu pour les véhicules venant du bas
+        { 75, 430, true },
+        { 560, 543, false }
+    };
 
 public:
-    User(float x, float y, const sf::Texture& texture, float speed, bool isHorizontal, bool goingPositive, bool turnLeftAtCenter = false, bool turnRightAtCenter = false)
-        : speed(speed), currentSpeed(speed), isHorizontal(isHorizontal), goingPositive(goingPositive), hasTurned(false), turnLeftAtCenter(turnLeftAtCenter), turnRightAtCenter(turnRightAtCenter) {
-        sprite.setTexture(texture);
-        sprite.setPosition(x, y);
-
-        // Dimensions cibles pour la voiture
-        float targetWidth = 40.0f;
-        float targetHeight = 20.0f;
-
-        // Calcul de l'chelle ncessaire
-        float scaleX = targetWidth / texture.getSize().x;
-        float scaleY = targetHeight / texture.getSize().y;
+    TrafficLightRenderer() : lights(sf::Quads, LIGHT_COUNT * 4) {
+        for (int l = 0; l < LIGHT_COUNT; ++l) {
+            const LightPlacement& light = placements[l];
+            lights[l * 4 + 0].position = sf::Vector2f(light.x, light.y);
+            lights[l * 4 + 1].position = sf::Vector2f(light.x + LIGHT_SIZE, light.y);
+            lights[l * 4 + 2].position = sf::Vector2f(light.x + LIGHT_SIZE, light.y + LIGHT_SIZE);
+            lights[l * 4 + 3].position = sf::Vector2f(light.x, light.y + LIGHT_SIZE);
+        }
+    }
 
-        // Appliquer l'chelle
-        sprite.setScale(scaleX, scaleY);
+    // Couleurs des feux horizontaux et verticaux pour chaque état
+    static sf::Color horizontalColor(TrafficLightState state) {
+        switch (state) {
+        case GreenHorizontal:
+            return sf::Color::Green;
+        case OrangeHorizontal:
+            return sf::Color(255, 165, 0); // Orange
+        default:
+            return sf::Color::Red;
+        }
+    }
 
-        // Ajuster l'orientation pour les vhicules
-        if (!isHorizontal) {
-            sprite.setRotation(90); // Vertical (vers le haut par dfaut)
-            if (!goingPositive) {
-                sprite.setRotation(270); // Vers le bas
-            }
+    static sf::Color verticalColor(TrafficLightState state) {
+        switch (state) {
+        case RedHorizontalOrangeVertical:
+            return sf::Color::Green;
+        case RedHorizontal:
+            return sf::Color(255, 165, 0); // Orange
+        default:
+            return sf::Color::Red;
         }
-        else {
-            if (!goingPositive) {
-                sprite.setRotation(180); // Vers la gauche
+    }
+
+    void draw(sf::RenderTarget& target, TrafficLightState state) {
+        sf::Color horizontal = horizontalColor(state);
+        sf::Color vertical = verticalColor(state);
+        for (int l = 0; l < LIGHT_COUNT; ++l) {
+            for (int c = 0; c < 4; ++c) {
+                lights[l * 4 + c].color = placements[l].horizontal ? horizontal : vertical;
             }
         }
+        target.draw(lights);
     }
+};
 
-    void ralentirProgressivement() {
-        speed = currentSpeed / 2; // Rduit la vitesse progressivement
-    }
 
-    void stop() {
-        speed = 0;
-        stopped = true;
-    }
-    void start() {
-        if (!stopped) return;
-        stopped = false;
-        speed = currentSpeed;
+// Couche statique (fond et feux) dessinée une fois dans une texture, puis recomposée seulement
+// quand la phase des feux change ou que le fond finit de charger : une image ne coûte plus
+// qu'une copie de cette texture, plus les usagers.
+class StaticLayer {
+public:
+    bool create() {
+        if (!target.create(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+            return false;
+        }
+        sprite.setTexture(target.getTexture(), true);
+        return true;
     }
 
+    // background : nul tant que l'image de fond n'est pas chargée
+    void draw(sf::RenderWindow& window, const sf::Sprite* background, TrafficLightRenderer& lights, TrafficLightState state) {
+        bool hasBackground = background != nullptr;
+        if (!composed || state != composedState || hasBackground != composedBackground) {
+            target.clear();
+            if (background) {
+                target.draw(*background);
+            }
+            lights.draw(target, state);
+            target.display();
+            composed = true;
+            composedState = state;
+            composedBackground = hasBackground;
+        }
+        window.draw(sprite);
+    }
 
+private:
+    sf::RenderTexture target;
+    sf::Sprite sprite;
+    bool composed = false;
+    TrafficLightState composedState = RedHorizontal;
+    bool composedBackground = false;
+};
 
-    virtual void move(TrafficLightState lightState) {
-        // Positions de la ligne d'arrt
 
-        const float stopLineXLeft = 120;   // Ligne d'arrt pour les vhicules venant de la gauche
-        const float stopLineXRight = 675; // Ligne d'arrt pour les vhicules venant de la droite
-        const float stopLineYTop = 75;    // Ligne d'arrt pour les vhicules venant du haut
-        const float stopLineYBottom = 515; // Ligne d'arrt pour les vhicules venant du bas
-        const float stopLineXleft2 = 20;
-        const float stopLineYBottom2 = 593;
+// Empreinte FNV-1a sur 64 bits, calculée sur la représentation exacte des valeurs
+struct Fingerprint {
+    std::uint64_t value = 14695981039346656037ull;
 
-        // Grer les virages au centre de l'intersection
-        if (!hasTurned) {
-            if (turnLeftAtCenter && isHorizontal && sprite.getPosition().x > 370 && sprite.getPosition().x < 380) {
-                isHorizontal = false;
-                goingPositive = true; // Tourne vers le bas
-                sprite.setRotation(90);
-                hasTurned = true;
-                return;
-            }
-            if (turnLeftAtCenter && !isHorizontal && sprite.getPosition().y > 275 && sprite.getPosition().y < 285) {
-                isHorizontal = true;
-                goingPositive = false; // Tourne  gauche
-                sprite.setRotation(180);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && isHorizontal && sprite.getPosition().x > 435 && sprite.getPosition().x < 445) {
-                isHorizontal = false;
-                goingPositive = false; // Tourne vers le haut
-                sprite.setRotation(270);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && !isHorizontal && sprite.getPosition().y > 310 && sprite.getPosition().y < 320) {
-                isHorizontal = true;
-                goingPositive = true; // Tourne  droite
-                sprite.setRotation(0);
-                hasTurned = true;
-                return;
-            }
+    void addBytes(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t k = 0; k < size; ++k) {
+            value = (value ^ bytes[k]) * 1099511628211ull;
         }
+    }
 
-        // Dplacement en fonction des feux de circulation
-        if (isHorizontal) {
-            // Mouvement horizontal
-            if (lightState == GreenHorizontal) {
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Dplacement si feu vert
-            }
-            else if (lightState == OrangeHorizontal || lightState == RedHorizontalOrangeVertical || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().x >= stopLineXleft2 && sprite.getPosition().x < 40) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
-                }
-                if (goingPositive && sprite.getPosition().x >= stopLineXLeft && sprite.getPosition().x < 140) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
-                }
-                if (!goingPositive && sprite.getPosition().x <= stopLineXRight && sprite.getPosition().x > 655) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la gauche
-                }
-                sprite.move((goingPositive ? speed : -speed), 0); // Mouvement aprs avoir pass la ligne
-            }
-        }
-        else {
-            // Mouvement vertical
-            if (lightState == RedHorizontalOrangeVertical) {
-                sprite.move(0, (goingPositive ? speed : -speed)); // Dplacement si feu vert pour direction verticale
-                start();
-            }
-            else if (lightState == GreenHorizontal || lightState == OrangeHorizontal || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().y >= stopLineYTop && sprite.getPosition().y < 95) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules descendant
-                }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom && sprite.getPosition().y > 495) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
-                }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom2 && sprite.getPosition().y > 560) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
-                }
-                sprite.move(0, (goingPositive ? speed : -speed)); // Mouvement aprs avoir pass la ligne
-            }
-        }
+    template <typename T>
+    void add(const T& scalar) {
+        static_assert(std::is_arithmetic_v<T>, "champ par champ, pour ne pas lire d'octets de bourrage");
+        addBytes(&scalar, sizeof(scalar));
+    }
+
+    void add(const std::string& text) {
+        add(static_cast<std::uint64_t>(text.size()));
+        addBytes(text.data(), text.size());
     }
+};
 
 
+// Cap d'un usager (même numérotation que les directions d'apparition)
+enum Heading : std::uint8_t { HeadingEast, HeadingWest, HeadingSouth, HeadingNorth };
+const int HEADING_COUNT = 4;
+const char* const HEADING_NAMES[HEADING_COUNT] = { "east", "west", "south", "north" }; // Noms dans les fichiers
 
-    void draw(sf::RenderWindow& window) { window.draw(sprite); }
-    virtual ~User() = default;
+bool isHorizontalHeading(std::uint8_t heading) { return heading == HeadingEast || heading == HeadingWest; }
+bool isPositiveHeading(std::uint8_t heading) { return heading == HeadingEast || heading == HeadingSouth; }
+
+// Manoeuvres d'un usager (champ de bits)
+enum AgentFlag : std::uint8_t {
+    FlagTurnLeft = 1,   // Doit tourner à gauche au centre
+    FlagTurnRight = 2,  // Doit tourner à droite au centre
+    FlagTurned = 4,     // A déjà tourné
+    FlagConflict = 8    // A déjà chevauché un usager d'une autre voie dans le carrefour
 };
 
+// Voie occupée : chaque type d'usager a sa propre voie dans chaque sens
+std::uint8_t laneOf(std::uint8_t kind, std::uint8_t heading) {
+    return static_cast<std::uint8_t>(kind * HEADING_COUNT + heading);
+}
 
 
-class Bus : public User {
-private:
-    bool stopped = false;
-public:
-    Bus(float x, float y, const sf::Texture& texture, bool isHorizontal, bool goingPositive, bool turnLeftAtCenter = false, bool turnRightAtCenter = false)
-        : User(x, y, texture, 0.075f, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter) {
-        // Ajuster l'chelle spcifique pour le bus
-        float targetWidth = 60.0f;
-        float targetHeight = 30.0f;
+// Géométrie d'une approche (un type d'usager arrivant avec un cap donné).
+// Les coordonnées "le long de l'axe" sont des x pour un cap horizontal, des y sinon.
+const int MAX_STOP_LINES = 4;
+
+struct ApproachGeometry {
+    float spawnX = 0, spawnY = 0;          // Point d'apparition
+    std::uint8_t signalGroup = 0;          // 0 : feux horizontaux, 1 : feux verticaux
+    float turnLeftAt = 0;                  // Point de virage à gauche le long de l'axe
+    float turnRightAt = 0;                 // Point de virage à droite le long de l'axe
+    std::uint8_t turnLeftHeading = 0;      // Cap après le virage à gauche
+    std::uint8_t turnRightHeading = 0;     // Cap après le virage à droite
+    int stopCount = 0;
+    float stopLine[MAX_STOP_LINES] = {};   // Lignes d'arrêt le long de l'axe
+    float zoneEnd[MAX_STOP_LINES] = {};    // Fin de la zone d'arrêt (dans le sens de déplacement)
+};
 
-        // Calcul de l'chelle ncessaire
-        float scaleX = targetWidth / texture.getSize().x;
-        float scaleY = targetHeight / texture.getSize().y;
+// Type d'usager : vitesse, taille affichée et une géométrie par cap
+struct KindGeometry {
+    std::string name;
+    float speed = 0;                       // Vitesse de croisière (m/s)
+    float width = 0, height = 0;           // Taille du sprite (pixels)
+    std::string texture;                   // Image du sprite
+    // Paramètres du modèle de poursuite (Intelligent Driver Model)
+    float accel = 1.5f;                    // Accélération maximale (m/s²)
+    float decel = 2.0f;                    // Décélération confortable (m/s²)
+    float minGap = 2.0f;                   // Distance minimale à l'arrêt (m)
+    float headway = 1.5f;                  // Temps inter-véhiculaire souhaité (s)
+    ApproachGeometry approach[HEADING_COUNT];
+
+    float length() const { return width / PIXELS_PER_METER; } // Longueur le long du cap (m)
+};
 
-        // Appliquer l'chelle
-        sprite.setScale(scaleX, scaleY);
+// Table des types d'usagers, indexée par le champ kind de AgentStore
+struct GeometryTable {
+    std::vector<KindGeometry> kinds;
+};
 
-        // Ajuster l'orientation pour les bus
-        if (!isHorizontal) {
-            sprite.setRotation(90); // Vertical (vers le haut par dfaut)
-            if (!goingPositive) {
-                sprite.setRotation(270); // Vers le bas
-            }
-        }
-        else {
-            if (!goingPositive) {
-                sprite.setRotation(180); // Vers la gauche
+// Empreinte de tous les champs de la table : un état enregistré (instantané, journal de rejeu)
+// n'est repris qu'avec la géométrie qui l'a produit (cases de SpatialHash, lignes d'arrêt, voies)
+std::uint64_t geometryFingerprint(const GeometryTable& table) {
+    Fingerprint fingerprint;
+    fingerprint.add(static_cast<std::uint64_t>(table.kinds.size()));
+    for (const KindGeometry& kind : table.kinds) {
+        fingerprint.add(kind.name);
+        fingerprint.add(kind.speed);
+        fingerprint.add(kind.width);
+        fingerprint.add(kind.height);
+        fingerprint.add(kind.texture);
+        fingerprint.add(kind.accel);
+        fingerprint.add(kind.decel);
+        fingerprint.add(kind.minGap);
+        fingerprint.add(kind.headway);
+        for (const ApproachGeometry& approach : kind.approach) {
+            fingerprint.add(approach.spawnX);
+            fingerprint.add(approach.spawnY);
+            fingerprint.add(approach.signalGroup);
+            fingerprint.add(approach.turnLeftAt);
+            fingerprint.add(approach.turnRightAt);
+            fingerprint.add(approach.turnLeftHeading);
+            fingerprint.add(approach.turnRightHeading);
+            fingerprint.add(approach.stopCount);
+            for (int k = 0; k < MAX_STOP_LINES; ++k) {
+                fingerprint.add(approach.stopLine[k]);
+                fingerprint.add(approach.zoneEnd[k]);
             }
         }
     }
+    return fingerprint.value;
+}
 
+// Remplit les champs déduits de l'axe : groupe de feux et caps après virage
+void setApproachDefaults(ApproachGeometry& approach, std::uint8_t heading) {
+    bool horizontal = isHorizontalHeading(heading);
+    approach.signalGroup = horizontal ? 0 : 1;
+    approach.turnLeftHeading = horizontal ? HeadingSouth : HeadingWest;
+    approach.turnRightHeading = horizontal ? HeadingNorth : HeadingEast;
+}
 
-    void move(TrafficLightState lightState) override {
-        // Positions de la ligne d'arrt
-        const float stopLineXLeft = 100;   // Ligne d'arrt pour les vhicules venant de la gauche
-        const float stopLineXRight = 695; // Ligne d'arrt pour les vhicules venant de la droite
-        const float stopLineYTop = 55;    // Ligne d'arrt pour les vhicules venant du haut
-        const float stopLineYBottom = 535; // Ligne d'arrt pour les vhicules venant du bas
-        const float stopLineXLeft2 = 0;
-        const float stopLineYBottom2 = 613;
+ApproachGeometry makeApproach(std::uint8_t heading, float spawnX, float spawnY, float turnLeftAt, float turnRightAt, std::initializer_list<std::pair<float, float>> stops) {
+    ApproachGeometry approach;
+    setApproachDefaults(approach, heading);
+    approach.spawnX = spawnX;
+    approach.spawnY = spawnY;
+    approach.turnLeftAt = turnLeftAt;
+    approach.turnRightAt = turnRightAt;
+    for (const auto& stop : stops) {
+        approach.stopLine[approach.stopCount] = stop.first;
+        approach.zoneEnd[approach.stopCount] = stop.second;
+        ++approach.stopCount;
+    }
+    return approach;
+}
 
-        // Grer les virages au centre de l'intersection
-        if (!hasTurned) {
-            if (turnLeftAtCenter && isHorizontal && sprite.getPosition().x > 305 && sprite.getPosition().x < 315) {
-                isHorizontal = false;
-                goingPositive = true; // Tourne vers le bas
-                sprite.setRotation(90);
-                hasTurned = true;
-                return;
-            }
-            if (turnLeftAtCenter && !isHorizontal && sprite.getPosition().y > 230 && sprite.getPosition().y < 240) {
-                isHorizontal = true;
-                goingPositive = false; // Tourne  gauche
-                sprite.setRotation(180);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && isHorizontal && sprite.getPosition().x > 475 && sprite.getPosition().x < 485) {
-                isHorizontal = false;
-                goingPositive = false; // Tourne vers le haut
-                sprite.setRotation(270);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && !isHorizontal && sprite.getPosition().y > 355 && sprite.getPosition().y < 365) {
-                isHorizontal = true;
-                goingPositive = true; // Tourne  droite
-                sprite.setRotation(0);
-                hasTurned = true;
-                return;
-            }
+KindGeometry makeKind(const std::string& name, float speed, float width, float height, const std::string& texture, float accel, float decel, float minGap, float headway) {
+    KindGeometry kind;
+    kind.name = name;
+    kind.speed = speed;
+    kind.width = width;
+    kind.height = height;
+    kind.texture = texture;
+    kind.accel = accel;
+    kind.decel = decel;
+    kind.minGap = minGap;
+    kind.headway = headway;
+    return kind;
+}
+
+// Géométrie du carrefour de la carte 800x600 (voitures, bus, vélos, piétons)
+GeometryTable defaultGeometry() {
+    GeometryTable table;
+
+    KindGeometry car = makeKind("car", CAR_SPEED, 40.0f, 20.0f, "car.png", 1.5f, 2.0f, 2.0f, 1.5f);
+    car.approach[HeadingEast] = makeApproach(HeadingEast, 0, 315, 375, 440, { { 20, 40 }, { 120, 140 } });
+    car.approach[HeadingWest] = makeApproach(HeadingWest, WINDOW_WIDTH, 280, 375, 440, { { 675, 655 } });
+    car.approach[HeadingSouth] = makeApproach(HeadingSouth, 375, 0, 280, 315, { { 75, 95 } });
+    car.approach[HeadingNorth] = makeApproach(HeadingNorth, 440, WINDOW_HEIGHT, 280, 315, { { 515, 495 }, { 593, 560 } });
+    table.kinds.push_back(car);
+
+    KindGeometry bus = makeKind("bus", BUS_SPEED, 60.0f, 30.0f, "bus.png", 1.0f, 1.5f, 2.5f, 1.8f);
+    bus.approach[HeadingEast] = makeApproach(HeadingEast, 0, 360, 310, 480, { { 0, 30 }, { 100, 130 } });
+    bus.approach[HeadingWest] = makeApproach(HeadingWest, WINDOW_WIDTH, 235, 310, 480, { { 695, 665 } });
+    bus.approach[HeadingSouth] = makeApproach(HeadingSouth, 320, 0, 235, 360, { { 55, 85 } });
+    bus.approach[HeadingNorth] = makeApproach(HeadingNorth, 490, WINDOW_HEIGHT, 235, 360, { { 535, 505 }, { 613, 583 } });
+    table.kinds.push_back(bus);
+
+    KindGeometry bike = makeKind("bike", BIKE_SPEED, 30.0f, 15.0f, "cyclist.png", 1.0f, 1.5f, 1.0f, 1.0f);
+    bike.approach[HeadingEast] = makeApproach(HeadingEast, 0, 405, 265, 530, { { 30, 35 }, { 130, 150 } });
+    bike.approach[HeadingWest] = makeApproach(HeadingWest, WINDOW_WIDTH, 190, 265, 530, { { 665, 645 } });
+    bike.approach[HeadingSouth] = makeApproach(HeadingSouth, 260, 0, 190, 405, { { 85, 105 } });
+    bike.approach[HeadingNorth] = makeApproach(HeadingNorth, 535, WINDOW_HEIGHT, 190, 405, { { 505, 485 }, { 583, 562 } });
+    table.kinds.push_back(bike);
+
+    KindGeometry pedestrian = makeKind("pedestrian", PEDESTRIAN_SPEED, 15.0f, 30.0f, "pieton.png", 0.5f, 1.0f, 0.5f, 0.5f);
+    pedestrian.approach[HeadingEast] = makeApproach(HeadingEast, 0, 440, 225, 565, { { 145, 200 } });
+    pedestrian.approach[HeadingWest] = makeApproach(HeadingWest, WINDOW_WIDTH, 160, 225, 565, { { 650, 580 } });
+    pedestrian.approach[HeadingSouth] = makeApproach(HeadingSouth, 225, 0, 160, 440, { { 100, 140 } });
+    pedestrian.approach[HeadingNorth] = makeApproach(HeadingNorth, 565, WINDOW_HEIGHT, 160, 440, { { 490, 450 } });
+    table.kinds.push_back(pedestrian);
+
+    return table;
+}
+
+// Charge une table de géométrie depuis un fichier texte. Une ligne par type puis une par approche :
+//   kind <nom> <vitesse m/s> <largeur> <hauteur> <image> [<accélération> <décélération> <distance min> <temps inter-véhiculaire>]
+//   approach <nom> <east|west|south|north> <x> <y> <virage gauche> <virage droite> [<ligne> <fin de zone>]...
+// Les lignes vides et celles commençant par # sont ignorées.
+bool loadGeometry(const std::string& path, GeometryTable& table) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Erreur : Impossible d'ouvrir la géométrie " << path << " !" << std::endl;
+        return false;
+    }
+
+    GeometryTable loaded;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword) || keyword[0] == '#') {
+            continue;
         }
 
-        // Dplacement en fonction des feux de circulation
-        if (isHorizontal) {
-            // Mouvement horizontal
-            if (lightState == GreenHorizontal) {
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Dplacement si feu vert
+        // Raison du refus de la ligne (vide si elle est valide)
+        std::string error;
+        std::string extra;
+        if (keyword == "kind") {
+            KindGeometry kind;
+            float idm[4];
+            int idmCount = 0;
+            if (!(fields >> kind.name >> kind.speed >> kind.width >> kind.height >> kind.texture)) {
+                error = "nom, vitesse, largeur, hauteur et image attendus";
             }
-            else if (lightState == OrangeHorizontal || lightState == RedHorizontalOrangeVertical || lightState == RedHorizontal) {
-
-                if (goingPositive && sprite.getPosition().x >= stopLineXLeft2 && sprite.getPosition().x < 30) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
+            else if (!(kind.speed > 0 && kind.width > 0 && kind.height > 0)) {
+                error = "vitesse, largeur et hauteur doivent être positives";
+            }
+            else if (std::any_of(loaded.kinds.begin(), loaded.kinds.end(), [&](const KindGeometry& k) { return k.name == kind.name; })) {
+                error = "type " + kind.name + " déjà défini";
+            }
+            else {
+                while (idmCount < 4 && fields >> idm[idmCount]) {
+                    ++idmCount;
                 }
-
-                if (goingPositive && sprite.getPosition().x >= stopLineXLeft && sprite.getPosition().x < 130) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
+                if (idmCount != 0 && idmCount != 4) {
+                    error = "les quatre paramètres du modèle de poursuite ou aucun";
                 }
-                if (!goingPositive && sprite.getPosition().x <= stopLineXRight && sprite.getPosition().x > 665) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la gauche
+                else if (idmCount == 4 && !(idm[0] > 0 && idm[1] > 0 && idm[2] >= 0 && idm[3] >= 0)) {
+                    error = "accélération et décélération positives, distance et temps inter-véhiculaire non négatifs";
                 }
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Mouvement aprs avoir pass la ligne
-            }
-        }
-        else {
-            // Mouvement vertical
-            if (lightState == RedHorizontalOrangeVertical) {
-                start();
-                sprite.move(0, (goingPositive ? speed : -speed)); // Dplacement si feu vert pour direction verticale
             }
-            else if (lightState == GreenHorizontal || lightState == OrangeHorizontal || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().y >= stopLineYTop && sprite.getPosition().y < 85) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules descendant
-                }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom && sprite.getPosition().y > 505) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
+            if (error.empty()) {
+                if (idmCount == 4) {
+                    kind.accel = idm[0];
+                    kind.decel = idm[1];
+                    kind.minGap = idm[2];
+                    kind.headway = idm[3];
                 }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom2 && sprite.getPosition().y > 583) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
+                for (int h = 0; h < HEADING_COUNT; ++h) {
+                    setApproachDefaults(kind.approach[h], static_cast<std::uint8_t>(h));
                 }
-                start();
-                sprite.move(0, (goingPositive ? speed : -speed)); // Mouvement aprs avoir pass la ligne
+                loaded.kinds.push_back(kind);
             }
         }
-    }
-};
-
-class Bike : public User {
-private:
-    bool stopped = false;
-public:
-    Bike(float x, float y, const sf::Texture& texture, bool isHorizontal, bool goingPositive, bool turnLeftAtCenter = false, bool turnRightAtCenter = false)
-        : User(x, y, texture, 0.05f, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter) {
-
-        // Ajuster l'chelle spcifique pour le vlo
-        float targetWidth = 30.0f;
-        float targetHeight = 15.0f;
-
-        float scaleX = targetWidth / texture.getSize().x;
-        float scaleY = targetHeight / texture.getSize().y;
-
-        sprite.setScale(scaleX, scaleY);
-
-        if (!isHorizontal) {
-            sprite.setRotation(90); // Mouvement vertical par dfaut
-            if (!goingPositive) {
-                sprite.setRotation(270); // Mouvement vers le bas
+        else if (keyword == "approach") {
+            std::string kindName, headingName;
+            fields >> kindName >> headingName;
+            auto kind = std::find_if(loaded.kinds.begin(), loaded.kinds.end(), [&](const KindGeometry& k) { return k.name == kindName; });
+            int heading = static_cast<int>(std::find(HEADING_NAMES, HEADING_NAMES + HEADING_COUNT, headingName) - HEADING_NAMES);
+            ApproachGeometry approach;
+            setApproachDefaults(approach, static_cast<std::uint8_t>(heading % HEADING_COUNT));
+            float stopLine, zoneEnd;
+            if (kind == loaded.kinds.end()) {
+                error = "type inconnu : " + kindName + " (à déclarer par une ligne kind avant ses approches)";
             }
-        }
-        else {
-            if (!goingPositive) {
-                sprite.setRotation(180); // Mouvement vers la gauche
-            }
-        }
-    }
-
-    void move(TrafficLightState lightState) override {
-        // Positions de la ligne d'arrt
-        const float stopLineXLeft = 130;   // Ligne d'arrt pour les vhicules venant de la gauche
-        const float stopLineXRight = 665; // Ligne d'arrt pour les vhicules venant de la droite
-        const float stopLineYTop = 85;    // Ligne d'arrt pour les vhicules venant du haut
-        const float stopLineYBottom = 505; // Ligne d'arrt pour les vhicules venant du bas
-        const float stopLineXLeft2 = 30;
-        const float stopLineYBottom2 = 583;
-
-        // Grer les virages au centre de l'intersection
-        if (!hasTurned) {
-            if (turnLeftAtCenter && isHorizontal && sprite.getPosition().x > 263 && sprite.getPosition().x < 267) {
-                isHorizontal = false;
-                goingPositive = true; // Tourne vers le bas
-                sprite.setRotation(90);
-                hasTurned = true;
-                return;
-            }
-            if (turnLeftAtCenter && !isHorizontal && sprite.getPosition().y > 188 && sprite.getPosition().y < 192) {
-                isHorizontal = true;
-                goingPositive = false; // Tourne  gauche
-                sprite.setRotation(180);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && isHorizontal && sprite.getPosition().x > 528 && sprite.getPosition().x < 532) {
-                isHorizontal = false;
-                goingPositive = false; // Tourne vers le haut
-                sprite.setRotation(270);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && !isHorizontal && sprite.getPosition().y > 403 && sprite.getPosition().y < 407) {
-                isHorizontal = true;
-                goingPositive = true; // Tourne  droite
-                sprite.setRotation(0);
-                hasTurned = true;
-                return;
-            }
-        }
-
-        // Dplacement en fonction des feux de circulation
-        if (isHorizontal) {
-            // Mouvement horizontal
-            if (lightState == GreenHorizontal) {
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Dplacement si feu vert
-            }
-            else if (lightState == OrangeHorizontal || lightState == RedHorizontalOrangeVertical || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().x >= stopLineXLeft2 && sprite.getPosition().x < 35) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
-                }
-                if (goingPositive && sprite.getPosition().x >= stopLineXLeft && sprite.getPosition().x < 150) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
-                }
-                if (!goingPositive && sprite.getPosition().x <= stopLineXRight && sprite.getPosition().x > 645) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la gauche
-                }
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Mouvement aprs avoir pass la ligne
+            else if (heading == HEADING_COUNT) {
+                error = "cap inconnu : " + headingName + " (east, west, south ou north)";
             }
-        }
-        else {
-            // Mouvement vertical
-            if (lightState == RedHorizontalOrangeVertical) {
-                start();
-                sprite.move(0, (goingPositive ? speed : -speed)); // Dplacement si feu vert pour direction verticale
+            else if (!(fields >> approach.spawnX >> approach.spawnY >> approach.turnLeftAt >> approach.turnRightAt)) {
+                error = "point d'apparition et points de virage attendus";
             }
-            else if (lightState == GreenHorizontal || lightState == OrangeHorizontal || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().y >= stopLineYTop && sprite.getPosition().y < 105) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules descendant
-                }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom && sprite.getPosition().y > 485) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
+            else {
+                while (error.empty() && fields >> stopLine) {
+                    if (!(fields >> zoneEnd)) {
+                        error = "fin de zone attendue après la ligne d'arrêt";
+                    }
+                    else if (approach.stopCount == MAX_STOP_LINES) {
+                        error = "au plus " + std::to_string(MAX_STOP_LINES) + " lignes d'arrêt";
+                    }
+                    else {
+                        approach.stopLine[approach.stopCount] = stopLine;
+                        approach.zoneEnd[approach.stopCount] = zoneEnd;
+                        ++approach.stopCount;
+                    }
                 }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom2 && sprite.getPosition().y > 562) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
-                }
-                start();
-                sprite.move(0, (goingPositive ? speed : -speed)); // Mouvement aprs avoir pass la ligne
             }
+            // Une approche redéfinie remplace la précédente (lignes d'arrêt comprises)
+            if (error.empty()) {
+                kind->approach[heading] = approach;
+            }
+        }
+        else {
+            error = "mot-clé inconnu : " + keyword;
+        }
+        if (error.empty()) {
+            fields.clear();
+            if (fields >> extra) {
+                error = "valeur en trop : " + extra;
+            }
+        }
+
+        if (!error.empty()) {
+            std::cerr << "Erreur : ligne " << lineNumber << " invalide dans " << path << " (" << error << ") !" << std::endl;
+            return false;
         }
     }
-};
 
-class Pedestrian : public User {
-private:
-    bool stopped = false;
-public:
-    Pedestrian(float x, float y, const sf::Texture& texture, bool isHorizontal, bool goingPositive, bool turnLeftAtCenter = false, bool turnRightAtCenter = false)
-        : User(x, y, texture, 0.03f, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter) {
+    if (loaded.kinds.empty() || loaded.kinds.size() > 64) {
+        std::cerr << "Erreur : " << path << " doit décrire entre 1 et 64 types d'usagers !" << std::endl;
+        return false;
+    }
+    table = loaded;
+    return true;
+}
 
-        // Ajuster l'chelle spcifique pour le vlo
-        float targetWidth = 15.0f;
-        float targetHeight = 30.0f;
 
-        float scaleX = targetWidth / texture.getSize().x;
-        float scaleY = targetHeight / texture.getSize().y;
+// Demande de trafic : débit d'arrivée de chaque type d'usager sur chaque approche d'entrée du
+// réseau (usagers par heure et par tuile d'entrée), modulé par un profil journalier.
+// Les arrivées suivent un processus de Poisson.
+struct DemandProfile {
+    std::vector<std::array<float, HEADING_COUNT>> ratePerHour;  // [type][cap]
+    std::vector<std::pair<double, float>> daily;                // (début en secondes depuis minuit, multiplicateur), trié
 
-        sprite.setScale(scaleX, scaleY);
+    static constexpr double DAY_SECONDS = 86400;
 
-        if (!isHorizontal) {
-            sprite.setRotation(90); // Mouvement vertical par dfaut
-            if (!goingPositive) {
-                sprite.setRotation(270); // Mouvement vers le bas
-            }
+    // Multiplicateur en vigueur à l'instant time (1 sans profil) ; le profil se répète chaque jour
+    float multiplier(double time) const {
+        if (daily.empty()) {
+            return 1;
         }
-        else {
-            if (!goingPositive) {
-                sprite.setRotation(180); // Mouvement vers la gauche
-            }
+        double timeOfDay = std::fmod(time, DAY_SECONDS);
+        auto next = std::upper_bound(daily.begin(), daily.end(), timeOfDay, [](double t, const std::pair<double, float>& entry) {
+            return t < entry.first;
+        });
+        // Avant la première entrée : la dernière entrée de la veille s'applique encore
+        return next == daily.begin() ? daily.back().second : std::prev(next)->second;
+    }
+
+    float maxMultiplier() const {
+        float highest = daily.empty() ? 1.0f : 0.0f;
+        for (const auto& entry : daily) {
+            highest = std::max(highest, entry.second);
         }
+        return highest;
+    }
+};
+
+// Demande par défaut : en moyenne un usager toutes les 3 secondes par tuile, type et cap uniformes
+DemandProfile defaultDemand(const GeometryTable& geometry) {
+    DemandProfile demand;
+    float rate = 3600.0f / 3.0f / (geometry.kinds.size() * HEADING_COUNT);
+    demand.ratePerHour.assign(geometry.kinds.size(), std::array<float, HEADING_COUNT>());
+    for (auto& rates : demand.ratePerHour) {
+        rates.fill(rate);
     }
+    return demand;
+}
 
-    void move(TrafficLightState lightState) override {
-        // Positions de la ligne d'arrt
-        const float stopLineXLeft = 145;   // Ligne d'arrt pour les vhicules venant de la gauche
-        const float stopLineXRight = 650; // Ligne d'arrt pour les vhicules venant de la droite
-        const float stopLineYTop = 100;    // Ligne d'arrt pour les vhicules venant du haut
-        const float stopLineYBottom = 490; // Ligne d'arrt pour les vhicules venant du bas
+// Charge une demande depuis un fichier texte (débits non cités : nuls) :
+//   rate <type> <east|west|south|north|all> <usagers par heure>
+//   profile <début en secondes depuis minuit> <multiplicateur>
+// Les lignes vides et celles commençant par # sont ignorées.
+bool loadDemand(const std::string& path, const GeometryTable& geometry, DemandProfile& demand) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Erreur : Impossible d'ouvrir la demande " << path << " !" << std::endl;
+        return false;
+    }
 
-        // Grer les virages au centre de l'intersection
-        if (!hasTurned) {
-            if (turnLeftAtCenter && isHorizontal && sprite.getPosition().x > 220 && sprite.getPosition().x < 230) {
-                isHorizontal = false;
-                goingPositive = true; // Tourne vers le bas
-                sprite.setRotation(90);
-                hasTurned = true;
-                return;
-            }
-            if (turnLeftAtCenter && !isHorizontal && sprite.getPosition().y > 155 && sprite.getPosition().y < 165) {
-                isHorizontal = true;
-                goingPositive = false; // Tourne  gauche
-                sprite.setRotation(180);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && isHorizontal && sprite.getPosition().x > 560 && sprite.getPosition().x < 570) {
-                isHorizontal = false;
-                goingPositive = false; // Tourne vers le haut
-                sprite.setRotation(270);
-                hasTurned = true;
-                return;
-            }
-            if (turnRightAtCenter && !isHorizontal && sprite.getPosition().y > 435 && sprite.getPosition().y < 445) {
-                isHorizontal = true;
-                goingPositive = true; // Tourne  droite
-                sprite.setRotation(0);
-                hasTurned = true;
-                return;
-            }
+    DemandProfile loaded;
+    loaded.ratePerHour.assign(geometry.kinds.size(), std::array<float, HEADING_COUNT>());
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword) || keyword[0] == '#') {
+            continue;
         }
 
-        // Dplacement en fonction des feux de circulation
-        if (isHorizontal) {
-            // Mouvement horizontal
-            if (lightState == GreenHorizontal) {
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Dplacement si feu vert
-            }
-            else if (lightState == OrangeHorizontal || lightState == RedHorizontalOrangeVertical || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().x >= stopLineXLeft && sprite.getPosition().x < 200) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la droite
+        bool ok = false;
+        if (keyword == "rate") {
+            std::string kindName, headingName;
+            float rate;
+            fields >> kindName >> headingName >> rate;
+            auto kind = std::find_if(geometry.kinds.begin(), geometry.kinds.end(), [&](const KindGeometry& k) { return k.name == kindName; });
+            int heading = static_cast<int>(std::find(HEADING_NAMES, HEADING_NAMES + HEADING_COUNT, headingName) - HEADING_NAMES);
+            if (fields && rate >= 0 && kind != geometry.kinds.end() && (heading < HEADING_COUNT || headingName == "all")) {
+                auto& rates = loaded.ratePerHour[kind - geometry.kinds.begin()];
+                if (heading < HEADING_COUNT) {
+                    rates[heading] = rate;
                 }
-                if (!goingPositive && sprite.getPosition().x <= stopLineXRight && sprite.getPosition().x > 580) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules allant vers la gauche
+                else {
+                    rates.fill(rate);
                 }
-                start();
-                sprite.move((goingPositive ? speed : -speed), 0); // Mouvement aprs avoir pass la ligne
+                ok = true;
             }
         }
-        else {
-            // Mouvement vertical
-            if (lightState == RedHorizontalOrangeVertical) {
-                start();
-                sprite.move(0, (goingPositive ? speed : -speed)); // Dplacement si feu vert pour direction verticale
-            }
-            else if (lightState == GreenHorizontal || lightState == OrangeHorizontal || lightState == RedHorizontal) {
-                if (goingPositive && sprite.getPosition().y >= stopLineYTop && sprite.getPosition().y < 140) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules descendant
-                }
-                if (!goingPositive && sprite.getPosition().y <= stopLineYBottom && sprite.getPosition().y > 450) {
-                    ralentirProgressivement();
-                    stop();
-                    return; // Arrt pour les vhicules montant
-                }
-                start();
-                sprite.move(0, (goingPositive ? speed : -speed)); // Mouvement aprs avoir pass la ligne
+        else if (keyword == "profile") {
+            double start;
+            float factor;
+            ok = static_cast<bool>(fields >> start >> factor) && start >= 0 && start < DemandProfile::DAY_SECONDS && factor >= 0;
+            if (ok) {
+                loaded.daily.emplace_back(start, factor);
             }
         }
-    }
-};
 
+        if (!ok) {
+            std::cerr << "Erreur : ligne " << lineNumber << " invalide dans " << path << " !" << std::endl;
+            return false;
+        }
+    }
 
-void generateRandomVehicle(std::vector<User>& users, std::vector<Bus>& buses, std::vector<Bike>& bikes, std::vector<Pedestrian>& pedestrians,
-    const sf::Texture& carTexture, const sf::Texture& busTexture, const sf::Texture& bikeTexture, const sf::Texture& pedestrianTexture) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> vehicleTypeDist(0, 3); // 0: Voiture, 1: Bus, 2: Vlo 3:pieton
-    std::uniform_int_distribution<int> directionDist(0, 3);
-    std::uniform_int_distribution<int> turnDecisionDist(0, 2);
-
-    int vehicleType = vehicleTypeDist(gen);
-    int direction = directionDist(gen);
-    int turnDecision = turnDecisionDist(gen);
+    std::sort(loaded.daily.begin(), loaded.daily.end());
+    demand = loaded;
+    return true;
+}
 
-    bool isHorizontal = direction < 2;
-    bool goingPositive = (direction == 0 || direction == 2);
-    bool turnLeftAtCenter = (turnDecision == 1);
-    bool turnRightAtCenter = (turnDecision == 2);
 
-    float x = 0, y = 0;
+// Marge autour de la fenêtre au-delà de laquelle un usager a quitté la carte (taille d'un bus)
+const float MAP_MARGIN = 60;
 
+bool hasLeftMap(float x, float y) {
+    return x < -MAP_MARGIN || x > WINDOW_WIDTH + MAP_MARGIN || y < -MAP_MARGIN || y > WINDOW_HEIGHT + MAP_MARGIN;
+}
 
 
-    // Dterminer la position initiale en fonction de la direction
-    if (direction == 0) { // Gauche -> Droite
-        x = 0;
-        y = 315;  // Position pour voiture allant  droite
-    }
-    else if (direction == 1) { // Droite -> Gauche
-        x = WINDOW_WIDTH;
-        y = 280;  // Position pour voiture allant  gauche
+// Magasin des usagers en structure de tableaux : les champs lus à chaque pas sont contigus.
+// Les sprites sont gérés à part par AgentRenderer.
+// Les positions le long de l'axe sont aussi exprimées en abscisse curviligne s = dirX * x + dirY * y,
+// croissante dans le sens de déplacement : le noyau de déplacement n'a alors plus de cas par cap.
+// Les usagers sont rangés sans trou : un usager retiré est remplacé par le dernier.
+struct AgentStore {
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> speed;           // Vitesse courante le long du cap (m/s)
+    std::vector<float> cruise;          // Vitesse de croisière (m/s)
+    std::vector<float> dirX;            // Direction de déplacement (-1, 0 ou 1)
+    std::vector<float> dirY;
+    std::vector<float> stopS;           // Prochaine ligne d'arrêt (s), infini s'il n'y en a plus
+    std::vector<float> zoneS;           // Fin de la zone d'arrêt de cette ligne (s)
+    std::vector<float> turnS;           // Point de virage (s), infini si l'usager ne tourne plus
+    std::vector<std::uint8_t> heading;  // Heading
+    std::vector<std::uint8_t> kind;     // Indice dans GeometryTable::kinds
+    std::vector<std::uint8_t> lane;     // Voir laneOf
+    std::vector<std::uint8_t> flags;    // AgentFlag
+    std::vector<std::uint8_t> signalGroup; // Groupe de feux de l'approche
+    std::vector<std::uint32_t> id;      // Identifiant stable (les lignes bougent lors des retraits)
+    std::vector<std::uint32_t> cell;    // Case de SpatialHash occupée (NO_CELL hors du carrefour)
+    std::vector<std::uint32_t> entryTick; // Pas d'entrée dans la tuile (modulo 2^32), pour le retard
+
+    // Ligne de chaque identifiant (NO_ROW si libre) ; les identifiants libérés sont réutilisés
+    static constexpr std::uint32_t NO_ROW = 0xFFFFFFFFu;
+    static constexpr std::uint32_t NO_CELL = 0xFFFFFFFFu;
+    std::vector<std::uint32_t> rowOfId;
+    std::vector<std::uint32_t> freeIds;
+
+    size_t size() const { return posX.size(); }
+    size_t row(std::uint32_t agentId) const { return rowOfId[agentId]; }
+    size_t capacity() const { return posX.capacity(); }
+
+    // Ajoute une ligne ; les champs dépendant de l'approche sont remplis par enterApproach
+    size_t add(std::uint8_t agentKind, std::uint8_t agentHeading, float x, float y, float agentCruise, std::uint8_t agentFlags) {
+        const float inf = std::numeric_limits<float>::infinity();
+        posX.push_back(x);
+        posY.push_back(y);
+        speed.push_back(agentCruise);
+        cruise.push_back(agentCruise);
+        dirX.push_back(0);
+        dirY.push_back(0);
+        stopS.push_back(inf);
+        zoneS.push_back(inf);
+        turnS.push_back(inf);
+        heading.push_back(agentHeading);
+        kind.push_back(agentKind);
+        lane.push_back(laneOf(agentKind, agentHeading));
+        flags.push_back(agentFlags);
+        signalGroup.push_back(0);
+        cell.push_back(NO_CELL);
+        entryTick.push_back(0);
+
+        std::uint32_t newId;
+        if (freeIds.empty()) {
+            newId = static_cast<std::uint32_t>(rowOfId.size());
+            rowOfId.push_back(0);
+        }
+        else {
+            newId = freeIds.back();
+            freeIds.pop_back();
+        }
+        id.push_back(newId);
+        rowOfId[newId] = static_cast<std::uint32_t>(size() - 1);
+        return size() - 1;
     }
-    else if (direction == 2) { // Haut -> Bas
-        x = 375;  // Position pour voiture allant vers le bas
-        y = 0;
+
+    // Retire l'usager i en O(1) ; l'usager qui était en dernière position prend sa place
+    void remove(size_t i) {
+        size_t last = size() - 1;
+        std::uint32_t removedId = id[i];
+        std::uint32_t movedId = id[last];
+        forEachColumn([&](auto& column) {
+            column[i] = column[last];
+            column.pop_back();
+        });
+        rowOfId[movedId] = static_cast<std::uint32_t>(i);
+        rowOfId[removedId] = NO_ROW;
+        freeIds.push_back(removedId);
     }
-    else if (direction == 3) { // Bas -> Haut
-        x = 440;  // Position pour voiture allant vers le haut
-        y = WINDOW_HEIGHT;
+
+    // Applique f à chacun des tableaux du magasin
+    template <typename F>
+    void forEachColumn(F f) {
+        f(posX); f(posY); f(speed); f(cruise); f(dirX); f(dirY); f(stopS); f(zoneS); f(turnS);
+        f(heading); f(kind); f(lane); f(flags); f(signalGroup); f(id); f(cell); f(entryTick);
     }
 
-    // Ajouter un vhicule (User ou Bus)
-    if (vehicleType == 0) {
-        // Positionner les voitures
-        users.emplace_back(x, y, carTexture, 0.1f, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter);
+    template <typename F>
+    void forEachColumn(F f) const {
+        f(posX); f(posY); f(speed); f(cruise); f(dirX); f(dirY); f(stopS); f(zoneS); f(turnS);
+        f(heading); f(kind); f(lane); f(flags); f(signalGroup); f(id); f(cell); f(entryTick);
     }
-    else if (vehicleType == 1) {
-        // Positionner les bus
-        if (direction == 0) { // Bus allant  droite
-            x = 0;
-            y = 360;
-        }
-        else if (direction == 1) { // Bus allant  gauche
-            y = 235;
-        }
-        else if (direction == 2) { // Bus allant vers le bas
-            x = 320;
-            y = 0;
-        }
-        else if (direction == 3) { // Bus allant vers le haut
-            x = 490;
-            y = WINDOW_HEIGHT;
+
+    // Recalcule la ligne de chaque identifiant après un remplissage direct des tableaux ;
+    // idCount identifiants ont été attribués, freeIds est fourni à part
+    void rebuildRows(size_t idCount) {
+        rowOfId.assign(idCount, NO_ROW);
+        for (size_t i = 0; i < size(); ++i) {
+            rowOfId[id[i]] = static_cast<std::uint32_t>(i);
         }
+    }
+};
 
-        // Appliquer le dcalage pour les bus
 
-        // Ajouter le bus  la liste
-        buses.emplace_back(x, y, busTexture, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter);
+// Abscisse curviligne de l'usager i le long de son cap (position de l'arrière du sprite)
+float pathPosition(const AgentStore& agents, size_t i) {
+    return agents.dirX[i] * agents.posX[i] + agents.dirY[i] * agents.posY[i];
+}
+
+
+// Files d'usagers par voie (voir laneOf), de l'usager le plus avancé (tête) au dernier arrivé.
+// Chaque usager ne lit que son prédécesseur immédiat : la poursuite coûte O(1) par usager,
+// sans test de collision entre toutes les paires.
+// Les files sont courtes (une voie de la carte) : un vector suffit et, contrairement à une deque,
+// ne coûte rien tant que la voie est vide, ce qui compte avec des milliers de carrefours.
+struct LaneQueues {
+    std::vector<std::vector<std::uint32_t>> lanes; // Identifiants d'usagers
+
+    void pushBack(std::uint8_t lane, std::uint32_t agentId) {
+        lanes[lane].push_back(agentId);
     }
-    else if (vehicleType == 2) {
-        // Positionner les bus
-        if (direction == 0) { // velo allant  droite
-            y = 405;
-            x = 0;
-        }
-        else if (direction == 1) { // velo allant  gauche
-            y = 190;
-        }
-        else if (direction == 2) { // velo allant vers le bas
-            x = 260;
-            y = 0;
-        }
-        else if (direction == 3) { // velo allant vers le haut
-            x = 535;
-            y = WINDOW_HEIGHT;
-        }
 
-        bikes.emplace_back(x, y, bikeTexture, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter);
+    // Retrait (en tête dans le cas courant d'une sortie de carte)
+    void remove(std::uint8_t lane, std::uint32_t agentId) {
+        auto& queue = lanes[lane];
+        queue.erase(std::find(queue.begin(), queue.end(), agentId));
     }
-    else {
-        // 
-        if (direction == 0) { // pieotn allant  droite
-            y = 440;
-        }
-        else if (direction == 1) { // pieton allant  gauche
-            y = 160;
-        }
-        else if (direction == 2) { // pieton allant vers le bas
-            x = 225;
-            y = 0;
-        }
-        else if (direction == 3) { // pieton allant vers le haut
-            x = 565;
-            y = WINDOW_HEIGHT;
-        }
 
-        pedestrians.emplace_back(x, y, pedestrianTexture, isHorizontal, goingPositive, turnLeftAtCenter, turnRightAtCenter);
+    // Insère à sa place un usager qui arrive en cours de voie (après un virage)
+    void insertByPosition(std::uint8_t lane, std::uint32_t agentId, const AgentStore& agents) {
+        auto& queue = lanes[lane];
+        float s = pathPosition(agents, agents.row(agentId));
+        auto it = std::find_if(queue.begin(), queue.end(), [&](std::uint32_t other) {
+            return pathPosition(agents, agents.row(other)) < s;
+        });
+        queue.insert(it, agentId);
     }
-}
+};
 
-void trafficLightThread(TrafficLight& light) {
-    while (true) {
-        switch (light.getState()) {
-        case RedHorizontal:
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-            break;
-        case GreenHorizontal:
-            std::this_thread::sleep_for(std::chrono::seconds(30));
-            break;
-        case OrangeHorizontal:
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-            break;
-        case RedHorizontalOrangeVertical:
-            std::this_thread::sleep_for(std::chrono::seconds(30));
-            break;
+
+// Choisit la ligne d'arrêt active : la plus proche dont la zone n'est pas encore dépassée
+void selectStopLine(AgentStore& agents, size_t i, const ApproachGeometry& approach) {
+    float s = agents.dirX[i] * agents.posX[i] + agents.dirY[i] * agents.posY[i];
+    float sign = agents.dirX[i] + agents.dirY[i];
+    agents.stopS[i] = std::numeric_limits<float>::infinity();
+    agents.zoneS[i] = std::numeric_limits<float>::infinity();
+    for (int k = 0; k < approach.stopCount; ++k) {
+        float zone = sign * approach.zoneEnd[k];
+        if (s < zone && zone < agents.zoneS[i]) {
+            agents.stopS[i] = sign * approach.stopLine[k];
+            agents.zoneS[i] = zone;
         }
-        light.changeState(); // Passe  l'tat suivant
     }
 }
 
+// Met à jour les champs dérivés de l'approche (direction, feu, virage, ligne d'arrêt) après
+// une apparition ou un virage
+void enterApproach(AgentStore& agents, size_t i, const GeometryTable& geometry, std::uint8_t newHeading) {
+    const ApproachGeometry& approach = geometry.kinds[agents.kind[i]].approach[newHeading];
+    float sign = isPositiveHeading(newHeading) ? 1.0f : -1.0f;
+    bool horizontal = isHorizontalHeading(newHeading);
+    agents.heading[i] = newHeading;
+    agents.lane[i] = laneOf(agents.kind[i], newHeading);
+    agents.dirX[i] = horizontal ? sign : 0;
+    agents.dirY[i] = horizontal ? 0 : sign;
+    agents.signalGroup[i] = approach.signalGroup;
+
+    std::uint8_t flags = agents.flags[i];
+    agents.turnS[i] = std::numeric_limits<float>::infinity();
+    if (!(flags & FlagTurned) && (flags & FlagTurnLeft)) {
+        agents.turnS[i] = sign * approach.turnLeftAt;
+    }
+    else if (!(flags & FlagTurned) && (flags & FlagTurnRight)) {
+        agents.turnS[i] = sign * approach.turnRightAt;
+    }
+    selectStopLine(agents, i, approach);
+}
 
+// Point d'apparition le long de l'axe (s) d'un type d'usager arrivant avec le cap heading
+float spawnPosition(const KindGeometry& kind, std::uint8_t heading) {
+    const ApproachGeometry& approach = kind.approach[heading];
+    float sign = isPositiveHeading(heading) ? 1.0f : -1.0f;
+    return sign * (isHorizontalHeading(heading) ? approach.spawnX : approach.spawnY);
+}
 
+size_t spawnAgent(AgentStore& agents, const GeometryTable& geometry, std::uint8_t kind, std::uint8_t heading, std::uint8_t flags) {
+    const KindGeometry& kindGeometry = geometry.kinds[kind];
+    const ApproachGeometry& approach = kindGeometry.approach[heading];
+    size_t i = agents.add(kind, heading, approach.spawnX, approach.spawnY, kindGeometry.speed, flags);
+    enterApproach(agents, i, geometry, heading);
+    return i;
+}
 
 
+// Nombre maximal de groupes de feux (un registre AVX de masques)
+const int MAX_SIGNAL_GROUPS = 8;
 
-int main() {
-    sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Traffic Simulation with Background");
+// Masque "feu non vert" de chaque groupe, sous forme de flottants tout-à-un / zéro
+void redMasksByGroup(TrafficLightState lightState, float redMask[MAX_SIGNAL_GROUPS]) {
+    const float allOnes = std::bit_cast<float>(0xFFFFFFFFu);
+    std::fill(redMask, redMask + MAX_SIGNAL_GROUPS, allOnes);
+    redMask[0] = lightState == GreenHorizontal ? 0.0f : allOnes;
+    redMask[1] = lightState == RedHorizontalOrangeVertical ? 0.0f : allOnes;
+}
 
-    sf::Texture backgroundTexture;
-    if (!backgroundTexture.loadFromFile("C:/Users/matheo.lesage-gante/Desktop/OneDrive/CIR2/Prog/Projet/img/background.jpg")) {
-        std::cerr << "Erreur : Impossible de charger l'image de fond !" << std::endl;
-        return -1;
-    }
-    sf::Sprite backgroundSprite;
-    backgroundSprite.setTexture(backgroundTexture);
-    backgroundSprite.setScale(
-        float(WINDOW_WIDTH) / backgroundTexture.getSize().x,
-        float(WINDOW_HEIGHT) / backgroundTexture.getSize().y
-    );
-
-    sf::Texture carTexture;
-    if (!carTexture.loadFromFile("C:/Users/matheo.lesage-gante/Desktop/OneDrive/CIR2/Prog/Projet/img/car.png")) {
-        std::cerr << "Erreur : Impossible de charger l'image de la voiture !" << std::endl;
-        return -1;
+// Noyau de déplacement pour les usagers [begin, end) : s += vitesse * dt (vitesse calculée par
+// followLeaders), sauf si le feu du groupe n'est pas vert et que l'usager est dans la zone d'arrêt ou atteint la ligne pendant ce pas
+// (il est alors posé sur la ligne et arrêté). Les usagers qui atteignent leur point de virage,
+// dépassent leur zone d'arrêt ou quittent la carte sont ajoutés à events pour un traitement scalaire.
+void stepAgentsScalar(AgentStore& agents, size_t begin, size_t end, const float redMask[MAX_SIGNAL_GROUPS], float dt, std::vector<std::uint32_t>& events) {
+    const float scale = PIXELS_PER_METER * dt;
+    for (size_t i = begin; i < end; ++i) {
+        float s = agents.dirX[i] * agents.posX[i] + agents.dirY[i] * agents.posY[i];
+        float d = agents.speed[i] * scale;
+        bool red = std::bit_cast<std::uint32_t>(redMask[agents.signalGroup[i]]) != 0;
+        bool hold = red && s < agents.zoneS[i] && s + d >= agents.stopS[i];
+        float ds = hold ? std::max(agents.stopS[i] - s, 0.0f) : d;
+        agents.posX[i] += agents.dirX[i] * ds;
+        agents.posY[i] += agents.dirY[i] * ds;
+        agents.speed[i] = hold ? 0.0f : agents.speed[i];
+
+        float sNew = s + ds;
+        if (sNew >= agents.turnS[i] || sNew >= agents.zoneS[i] || hasLeftMap(agents.posX[i], agents.posY[i])) {
+            events.push_back(static_cast<std::uint32_t>(i));
+        }
     }
+}
 
-    sf::Texture busTexture;
-    if (!busTexture.loadFromFile("C:/Users/matheo.lesage-gante/Desktop/OneDrive/CIR2/Prog/Projet/img/bus.png")) {
-        std::cerr << "Erreur : Impossible de charger l'image du bus !" << std::endl;
-        return -1;
+#if defined(__AVX2__)
+// Même noyau, 8 usagers par instruction (compiler avec -mavx2 ou /arch:AVX2)
+void stepAgents(AgentStore& agents, const float redMask[MAX_SIGNAL_GROUPS], float dt, std::vector<std::uint32_t>& events) {
+    const size_t n = agents.size();
+    const __m256 scale = _mm256_set1_ps(PIXELS_PER_METER * dt);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 redTable = _mm256_loadu_ps(redMask);
+    const __m256 minX = _mm256_set1_ps(-MAP_MARGIN), maxX = _mm256_set1_ps(WINDOW_WIDTH + MAP_MARGIN);
+    const __m256 minY = _mm256_set1_ps(-MAP_MARGIN), maxY = _mm256_set1_ps(WINDOW_HEIGHT + MAP_MARGIN);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(&agents.posX[i]);
+        __m256 y = _mm256_loadu_ps(&agents.posY[i]);
+        __m256 dx = _mm256_loadu_ps(&agents.dirX[i]);
+        __m256 dy = _mm256_loadu_ps(&agents.dirY[i]);
+        __m256 speed = _mm256_loadu_ps(&agents.speed[i]);
+        __m256 stop = _mm256_loadu_ps(&agents.stopS[i]);
+        __m256 zone = _mm256_loadu_ps(&agents.zoneS[i]);
+
+        __m256 s = _mm256_add_ps(_mm256_mul_ps(dx, x), _mm256_mul_ps(dy, y));
+        __m256 d = _mm256_mul_ps(speed, scale);
+        // Masque du feu : recherche du groupe de chaque usager dans la table des masques
+        __m256i group = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&agents.signalGroup[i])));
+        __m256 red = _mm256_permutevar8x32_ps(redTable, group);
+        __m256 hold = _mm256_and_ps(red, _mm256_and_ps(_mm256_cmp_ps(s, zone, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(s, d), stop, _CMP_GE_OQ)));
+        __m256 ds = _mm256_blendv_ps(d, _mm256_max_ps(_mm256_sub_ps(stop, s), zero), hold);
+
+        x = _mm256_add_ps(x, _mm256_mul_ps(dx, ds));
+        y = _mm256_add_ps(y, _mm256_mul_ps(dy, ds));
+        _mm256_storeu_ps(&agents.posX[i], x);
+        _mm256_storeu_ps(&agents.posY[i], y);
+        _mm256_storeu_ps(&agents.speed[i], _mm256_andnot_ps(hold, speed));
+
+        __m256 sNew = _mm256_add_ps(s, ds);
+        __m256 event = _mm256_or_ps(_mm256_cmp_ps(sNew, _mm256_loadu_ps(&agents.turnS[i]), _CMP_GE_OQ), _mm256_cmp_ps(sNew, zone, _CMP_GE_OQ));
+        event = _mm256_or_ps(event, _mm256_or_ps(_mm256_cmp_ps(x, minX, _CMP_LT_OQ), _mm256_cmp_ps(x, maxX, _CMP_GT_OQ)));
+        event = _mm256_or_ps(event, _mm256_or_ps(_mm256_cmp_ps(y, minY, _CMP_LT_OQ), _mm256_cmp_ps(y, maxY, _CMP_GT_OQ)));
+        for (int bits = _mm256_movemask_ps(event); bits != 0; bits &= bits - 1) {
+            events.push_back(static_cast<std::uint32_t>(i + std::countr_zero(static_cast<unsigned>(bits))));
+        }
     }
-
-    sf::Texture bikeTexture;
-    if (!bikeTexture.loadFromFile("C:/Users/matheo.lesage-gante/Desktop/OneDrive/CIR2/Prog/Projet/img/cyclist.png")) {
-        std::cerr << "Erreur : Impossible de charger l'image du vlo !" << std::endl;
-        return -1;
+    stepAgentsScalar(agents, i, n, redMask, dt, events);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+// Même noyau, 4 usagers par instruction (SSE2, disponible sur tout processeur x86-64)
+void stepAgents(AgentStore& agents, const float redMask[MAX_SIGNAL_GROUPS], float dt, std::vector<std::uint32_t>& events) {
+    const size_t n = agents.size();
+    const __m128 scale = _mm_set1_ps(PIXELS_PER_METER * dt);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 minX = _mm_set1_ps(-MAP_MARGIN), maxX = _mm_set1_ps(WINDOW_WIDTH + MAP_MARGIN);
+    const __m128 minY = _mm_set1_ps(-MAP_MARGIN), maxY = _mm_set1_ps(WINDOW_HEIGHT + MAP_MARGIN);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(&agents.posX[i]);
+        __m128 y = _mm_loadu_ps(&agents.posY[i]);
+        __m128 dx = _mm_loadu_ps(&agents.dirX[i]);
+        __m128 dy = _mm_loadu_ps(&agents.dirY[i]);
+        __m128 speed = _mm_loadu_ps(&agents.speed[i]);
+        __m128 stop = _mm_loadu_ps(&agents.stopS[i]);
+        __m128 zone = _mm_loadu_ps(&agents.zoneS[i]);
+
+        __m128 s = _mm_add_ps(_mm_mul_ps(dx, x), _mm_mul_ps(dy, y));
+        __m128 d = _mm_mul_ps(speed, scale);
+        const std::uint8_t* group = &agents.signalGroup[i];
+        __m128 red = _mm_set_ps(redMask[group[3]], redMask[group[2]], redMask[group[1]], redMask[group[0]]);
+        __m128 hold = _mm_and_ps(red, _mm_and_ps(_mm_cmplt_ps(s, zone), _mm_cmpge_ps(_mm_add_ps(s, d), stop)));
+        // Sélection sans branche : ds = hold ? max(stop - s, 0) : d
+        __m128 ds = _mm_or_ps(_mm_and_ps(hold, _mm_max_ps(_mm_sub_ps(stop, s), zero)), _mm_andnot_ps(hold, d));
+
+        x = _mm_add_ps(x, _mm_mul_ps(dx, ds));
+        y = _mm_add_ps(y, _mm_mul_ps(dy, ds));
+        _mm_storeu_ps(&agents.posX[i], x);
+        _mm_storeu_ps(&agents.posY[i], y);
+        _mm_storeu_ps(&agents.speed[i], _mm_andnot_ps(hold, speed));
+
+        __m128 sNew = _mm_add_ps(s, ds);
+        __m128 event = _mm_or_ps(_mm_cmpge_ps(sNew, _mm_loadu_ps(&agents.turnS[i])), _mm_cmpge_ps(sNew, zone));
+        event = _mm_or_ps(event, _mm_or_ps(_mm_cmplt_ps(x, minX), _mm_cmpgt_ps(x, maxX)));
+        event = _mm_or_ps(event, _mm_or_ps(_mm_cmplt_ps(y, minY), _mm_cmpgt_ps(y, maxY)));
+        for (int bits = _mm_movemask_ps(event); bits != 0; bits &= bits - 1) {
+            events.push_back(static_cast<std::uint32_t>(i + std::countr_zero(static_cast<unsigned>(bits))));
+        }
     }
-    sf::Texture pedestrianTexture;
-    if (!pedestrianTexture.loadFromFile("C:/Users/matheo.lesage-gante/Desktop/OneDrive/CIR2/Prog/Projet/img/pieton.png")) {
-        std::cerr << "Erreur : Impossible de charger l'image du piton !" << std::endl;
-        return -1;
+    stepAgentsScalar(agents, i, n, redMask, dt, events);
+}
+#else
+void stepAgents(AgentStore& agents, const float redMask[MAX_SIGNAL_GROUPS], float dt, std::vector<std::uint32_t>& events) {
+    stepAgentsScalar(agents, 0, agents.size(), redMask, dt, events);
+}
+#endif
+
+// Modèle de poursuite (Intelligent Driver Model) : chaque usager adapte sa vitesse à celle de son
+// prédécesseur dans la voie et, si son feu n'est pas vert, à sa ligne d'arrêt vue comme un obstacle
+// immobile. Les files sont parcourues de la tête à la queue ; la vitesse du prédécesseur utilisée est
+// celle du début du pas.
+// Le même parcours compte, par cap, les usagers arrêtés avant une ligne d'arrêt qu'ils n'ont pas encore
+// franchie (queued).
+void followLeaders(AgentStore& agents, const LaneQueues& lanes, const GeometryTable& geometry, const float redMask[MAX_SIGNAL_GROUPS], float dt,
+                   std::uint32_t queued[HEADING_COUNT]) {
+    const float inf = std::numeric_limits<float>::infinity();
+    const float maxBraking = 9.0f; // Freinage d'urgence (m/s²)
+    const float queueSpeed = 0.5f; // En dessous (m/s), un usager avant sa ligne d'arrêt est compté dans la file
+    for (size_t lane = 0; lane < lanes.lanes.size(); ++lane) {
+        const auto& queue = lanes.lanes[lane];
+        float leaderS = inf;        // Arrière du prédécesseur (s)
+        float leaderSpeed = 0;
+        std::uint32_t stopped = 0;
+        for (std::uint32_t agentId : queue) {
+            size_t i = agents.row(agentId);
+            const KindGeometry& kind = geometry.kinds[agents.kind[i]];
+            float s = pathPosition(agents, i);
+            float v = agents.speed[i];
+
+            // Distance libre devant l'usager (m) et vitesse de l'obstacle
+            float gap = (leaderS - s) / PIXELS_PER_METER - kind.length();
+            float obstacleSpeed = leaderSpeed;
+            bool red = std::bit_cast<std::uint32_t>(redMask[agents.signalGroup[i]]) != 0;
+            if (red && s < agents.stopS[i]) {
+                // La distance minimale est ajoutée pour que l'usager s'arrête sur la ligne et non avant
+                float stopGap = (agents.stopS[i] - s) / PIXELS_PER_METER + kind.minGap;
+                if (stopGap < gap) {
+                    gap = stopGap;
+                    obstacleSpeed = 0;
+                }
+            }
+
+            float ratio = v / kind.speed;
+            float a = kind.accel * (1 - ratio * ratio * ratio * ratio);
+            if (gap < inf) {
+                float desired = kind.minGap + std::max(0.0f, v * kind.headway + v * (v - obstacleSpeed) / (2 * std::sqrt(kind.accel * kind.decel)));
+                float interaction = desired / std::max(gap, 0.01f);
+                a -= kind.accel * interaction * interaction;
+            }
+            float newSpeed = std::clamp(v + std::max(a, -maxBraking) * dt, 0.0f, std::max(kind.speed, v));
+
+            // Jamais au-delà de l'arrière du prédécesseur pendant ce pas : l'ordre de la file est conservé
+            float room = std::max(0.0f, leaderS - s - kind.width);
+            newSpeed = std::min(newSpeed, room / (PIXELS_PER_METER * dt));
+
+            agents.speed[i] = newSpeed;
+            // Après la dernière ligne (stopS infini), un usager ralenti par son prédécesseur n'est plus dans une file de feu
+            stopped += newSpeed < queueSpeed && std::isfinite(agents.stopS[i]) && s < agents.stopS[i];
+            leaderS = s;
+            leaderSpeed = v;
+        }
+        queued[lane % HEADING_COUNT] += stopped; // Voir laneOf
     }
+}
 
-    TrafficLight trafficLight;
+// Traitement scalaire d'un usager signalé par stepAgents : virage au centre ou passage à la
+// ligne d'arrêt suivante (l'usager qui tourne change de file). Retourne vrai si l'usager a quitté
+// la carte et doit être retiré.
+bool applyAgentEvent(AgentStore& agents, size_t i, const GeometryTable& geometry, LaneQueues& lanes) {
+    if (hasLeftMap(agents.posX[i], agents.posY[i])) {
+        return true;
+    }
 
-    std::vector<User> users;
-    std::vector<Bus> buses;
-    std::vector<Bike> bikes;
-    std::vector<Pedestrian> pedestrians;
+    float s = agents.dirX[i] * agents.posX[i] + agents.dirY[i] * agents.posY[i];
+    if (s >= agents.turnS[i]) {
+        // L'usager tourne exactement au point de virage puis finit son pas dans la nouvelle direction
+        const ApproachGeometry& approach = geometry.kinds[agents.kind[i]].approach[agents.heading[i]];
+        bool left = (agents.flags[i] & FlagTurnLeft) != 0;
+        float remaining = s - agents.turnS[i];
+        std::uint8_t oldLane = agents.lane[i];
+        agents.posX[i] -= agents.dirX[i] * remaining;
+        agents.posY[i] -= agents.dirY[i] * remaining;
+        agents.flags[i] |= FlagTurned;
+        enterApproach(agents, i, geometry, left ? approach.turnLeftHeading : approach.turnRightHeading);
+        agents.posX[i] += agents.dirX[i] * remaining;
+        agents.posY[i] += agents.dirY[i] * remaining;
+        selectStopLine(agents, i, geometry.kinds[agents.kind[i]].approach[agents.heading[i]]);
+        lanes.remove(oldLane, agents.id[i]);
+        lanes.insertByPosition(agents.lane[i], agents.id[i], agents);
+    }
+    else {
+        selectStopLine(agents, i, geometry.kinds[agents.kind[i]].approach[agents.heading[i]]);
+    }
+    return false;
+}
 
-    std::thread lightThread(trafficLightThread, std::ref(trafficLight));
 
-    sf::Clock clock;
-    sf::Time spawnInterval = sf::seconds(3); // Intervalle pour ajouter un vhicule
+// Rectangle occupé par le sprite de l'usager i (mêmes rotations que AgentRenderer : le sprite
+// s'étend de sa largeur dans le sens du cap et de sa hauteur vers la droite du cap)
+sf::FloatRect agentBounds(const AgentStore& agents, size_t i, const GeometryTable& geometry) {
+    const KindGeometry& kind = geometry.kinds[agents.kind[i]];
+    float x = agents.posX[i];
+    float y = agents.posY[i];
+    switch (agents.heading[i]) {
+    case HeadingEast:
+        return sf::FloatRect(x, y, kind.width, kind.height);
+    case HeadingWest:
+        return sf::FloatRect(x - kind.width, y - kind.height, kind.width, kind.height);
+    case HeadingSouth:
+        return sf::FloatRect(x - kind.height, y, kind.height, kind.width);
+    default:
+        return sf::FloatRect(x, y - kind.width, kind.height, kind.width);
+    }
+}
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) {
-                window.close();
+// Grille uniforme sur le carrefour (la zone où les voies se croisent) pour la détection des
+// conflits. Chaque usager est rangé dans la case de son centre ; les cases font au moins la
+// taille du plus grand sprite, donc deux usagers qui se chevauchent sont dans des cases voisines
+// et une requête ne lit que les 3x3 cases autour de l'usager.
+// La grille est mise à jour à chaque pas sans être reconstruite : seuls les usagers qui ont
+// changé de case sont déplacés.
+class SpatialHash {
+public:
+    // Carrefour déduit des points de virage de toutes les approches, élargi d'un sprite
+    explicit SpatialHash(const GeometryTable& geometry) {
+        const float inf = std::numeric_limits<float>::infinity();
+        float minX = inf, maxX = -inf, minY = inf, maxY = -inf;
+        cellSize = 1;
+        for (const KindGeometry& kind : geometry.kinds) {
+            cellSize = std::max({ cellSize, kind.width, kind.height });
+            for (int h = 0; h < HEADING_COUNT; ++h) {
+                const ApproachGeometry& approach = kind.approach[h];
+                float low = std::min(approach.turnLeftAt, approach.turnRightAt);
+                float high = std::max(approach.turnLeftAt, approach.turnRightAt);
+                if (isHorizontalHeading(static_cast<std::uint8_t>(h))) {
+                    minX = std::min(minX, low);
+                    maxX = std::max(maxX, high);
+                }
+                else {
+                    minY = std::min(minY, low);
+                    maxY = std::max(maxY, high);
+                }
             }
         }
+        originX = minX - cellSize;
+        originY = minY - cellSize;
+        columns = static_cast<int>(std::ceil((maxX - minX) / cellSize)) + 2;
+        rows = static_cast<int>(std::ceil((maxY - minY) / cellSize)) + 2;
+        cells.resize(static_cast<size_t>(columns) * rows);
+    }
 
-        if (clock.getElapsedTime() >= spawnInterval) {
-            generateRandomVehicle(users, buses, bikes, pedestrians, carTexture, busTexture, bikeTexture, pedestrianTexture);
-            clock.restart();
+    // Range chaque usager dans la case de son centre (ou le sort de la grille)
+    void update(AgentStore& agents, const GeometryTable& geometry) {
+        for (size_t i = 0; i < agents.size(); ++i) {
+            sf::FloatRect bounds = agentBounds(agents, i, geometry);
+            std::uint32_t newCell = cellAt(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2);
+            if (newCell != agents.cell[i]) {
+                remove(agents, i);
+                if (newCell != AgentStore::NO_CELL) {
+                    cells[newCell].push_back(agents.id[i]);
+                }
+                agents.cell[i] = newCell;
+            }
         }
+    }
 
-        window.clear();
-        window.draw(backgroundSprite);
-        trafficLight.draw(window);
+    size_t cellCount() const { return cells.size(); }
 
-        TrafficLightState currentState = trafficLight.getState();
+    // Reconstruit les cases d'après le champ cell des usagers (après une restauration)
+    void rebuild(const AgentStore& agents) {
+        for (auto& members : cells) {
+            members.clear();
+        }
+        for (size_t i = 0; i < agents.size(); ++i) {
+            if (agents.cell[i] != AgentStore::NO_CELL) {
+                cells[agents.cell[i]].push_back(agents.id[i]);
+            }
+        }
+    }
 
-        // Mouvement et affichage des voitures
-        for (auto& user : users) {
-            user.move(currentState);
-            user.draw(window);
+    // À appeler avant AgentStore::remove
+    void remove(const AgentStore& agents, size_t i) {
+        if (agents.cell[i] == AgentStore::NO_CELL) {
+            return;
         }
+        auto& members = cells[agents.cell[i]];
+        *std::find(members.begin(), members.end(), agents.id[i]) = members.back();
+        members.pop_back();
+    }
 
-        // Mouvement et affichage des bus
-        for (auto& bus : buses) {
-            bus.move(currentState);
-            bus.draw(window);
+    // Marque les usagers de la grille qui chevauchent un usager d'une autre voie et retourne le
+    // nombre de nouveaux usagers marqués
+    int markConflicts(AgentStore& agents, const GeometryTable& geometry) const {
+        int newConflicts = 0;
+        for (size_t i = 0; i < agents.size(); ++i) {
+            if (agents.cell[i] == AgentStore::NO_CELL || (agents.flags[i] & FlagConflict)) {
+                continue;
+            }
+            int cx = static_cast<int>(agents.cell[i] % columns);
+            int cy = static_cast<int>(agents.cell[i] / columns);
+            if (overlapsOtherLane(agents, i, agentBounds(agents, i, geometry), cx, cy, geometry)) {
+                agents.flags[i] |= FlagConflict;
+                ++newConflicts;
+            }
         }
+        return newConflicts;
+    }
 
-        // Mouvement et affichage des vlos
-        for (auto& bike : bikes) {
-            bike.move(currentState);
-            bike.draw(window);
+private:
+    float originX = 0, originY = 0;
+    float cellSize = 1;
+    int columns = 0, rows = 0;
+    std::vector<std::vector<std::uint32_t>> cells; // Identifiants d'usagers par case
+
+    std::uint32_t cellAt(float x, float y) const {
+        int cx = static_cast<int>(std::floor((x - originX) / cellSize));
+        int cy = static_cast<int>(std::floor((y - originY) / cellSize));
+        if (cx < 0 || cx >= columns || cy < 0 || cy >= rows) {
+            return AgentStore::NO_CELL;
         }
+        return static_cast<std::uint32_t>(cy * columns + cx);
+    }
 
-        // Mouvement et affichage des pitons
-        for (auto& pedestrian : pedestrians) {
-            pedestrian.move(currentState);
-            pedestrian.draw(window);
+    bool overlapsOtherLane(const AgentStore& agents, size_t i, const sf::FloatRect& bounds, int cx, int cy, const GeometryTable& geometry) const {
+        for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, rows - 1); ++ny) {
+            for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, columns - 1); ++nx) {
+                for (std::uint32_t otherId : cells[static_cast<size_t>(ny) * columns + nx]) {
+                    size_t j = agents.row(otherId);
+                    if (agents.lane[j] != agents.lane[i] && bounds.intersects(agentBounds(agents, j, geometry))) {
+                        return true;
+                    }
+                }
+            }
         }
+        return false;
+    }
+};
 
-        window.display();
+
+// Image du monde transmise du thread de simulation au thread d'affichage : uniquement ce qui est
+// dessiné, pour le carrefour affiché
+struct WorldFrame {
+    TrafficLightState lightState = RedHorizontal;
+    double simTime = 0;
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<std::uint8_t> kind;
+    std::vector<std::uint8_t> heading;
+
+    size_t size() const { return posX.size(); }
+
+    // Les tableaux gardent leur capacité d'une image à l'autre : pas d'allocation en régime établi
+    void capture(const AgentStore& agents, TrafficLightState state, double time) {
+        lightState = state;
+        simTime = time;
+        posX.assign(agents.posX.begin(), agents.posX.end());
+        posY.assign(agents.posY.begin(), agents.posY.end());
+        kind.assign(agents.kind.begin(), agents.kind.end());
+        heading.assign(agents.heading.begin(), agents.heading.end());
     }
+};
 
-    lightThread.join();
+// Triple tampon sans verrou entre un seul écrivain et un seul lecteur. L'écrivain remplit son
+// tampon puis l'échange avec le tampon "prêt" ; le lecteur récupère le tampon prêt s'il est plus
+// récent que le sien. Aucun des deux n'attend l'autre et le lecteur voit toujours une image complète.
+template <typename T>
+class TripleBuffer {
+public:
+    // Tampon de l'écrivain
+    T& back() { return buffers[backIndex]; }
 
-    return 0;
+    void publish() {
+        backIndex = ready.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Dernière image publiée (ou la précédente si rien de nouveau)
+    const T& read() {
+        if (ready.load(std::memory_order_relaxed) & FRESH) {
+            frontIndex = ready.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+        return buffers[frontIndex];
+    }
+
+private:
+    static constexpr unsigned FRESH = 4;       // Le tampon prêt n'a pas encore été lu
+    static constexpr unsigned INDEX_MASK = 3;
+
+    T buffers[3];
+    unsigned backIndex = 0;                    // Propriété de l'écrivain
+    unsigned frontIndex = 1;                   // Propriété du lecteur
+    std::atomic<unsigned> ready{ 2 };
+};
+
+
+// Image RGBA 8 bits aux couleurs prémultipliées par l'alpha, telle qu'envoyée à la carte graphique
+struct PixelImage {
+    unsigned width = 0, height = 0;
+    std::vector<std::uint8_t> pixels;
+};
+
+// Réduit (ou agrandit) une image à la taille width x height en moyennant les pixels sources couverts
+// par chaque pixel de destination, après prémultiplication : pas de halo sombre autour des sprites.
+PixelImage scaleImage(const sf::Image& source, unsigned width, unsigned height) {
+    PixelImage result;
+    result.width = width;
+    result.height = height;
+    result.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    sf::Vector2u sourceSize = source.getSize();
+    const std::uint8_t* src = source.getPixelsPtr();
+    double scaleX = double(sourceSize.x) / width;
+    double scaleY = double(sourceSize.y) / height;
+    for (unsigned y = 0; y < height; ++y) {
+        unsigned y0 = static_cast<unsigned>(y * scaleY);
+        unsigned y1 = std::max(y0 + 1, std::min(sourceSize.y, static_cast<unsigned>(std::ceil((y + 1) * scaleY))));
+        for (unsigned x = 0; x < width; ++x) {
+            unsigned x0 = static_cast<unsigned>(x * scaleX);
+            unsigned x1 = std::max(x0 + 1, std::min(sourceSize.x, static_cast<unsigned>(std::ceil((x + 1) * scaleX))));
+            double sum[4] = {};
+            for (unsigned sy = y0; sy < y1; ++sy) {
+                for (unsigned sx = x0; sx < x1; ++sx) {
+                    const std::uint8_t* pixel = src + (static_cast<size_t>(sy) * sourceSize.x + sx) * 4;
+                    double alpha = pixel[3] / 255.0;
+                    sum[0] += pixel[0] * alpha;
+                    sum[1] += pixel[1] * alpha;
+                    sum[2] += pixel[2] * alpha;
+                    sum[3] += pixel[3];
+                }
+            }
+            double count = double(y1 - y0) * (x1 - x0);
+            std::uint8_t* out = &result.pixels[(static_cast<size_t>(y) * width + x) * 4];
+            for (int c = 0; c < 4; ++c) {
+                out[c] = static_cast<std::uint8_t>(std::lround(sum[c] / count));
+            }
+        }
+    }
+    return result;
+}
+
+// Range les images (une par sprite) par étagères : de la plus haute à la plus basse, de gauche à
+// droite, avec une nouvelle étagère quand la largeur maximale d'une texture est atteinte.
+// Une marge sépare les images pour que le filtrage ne mélange pas deux sprites voisins.
+bool packAtlas(const std::vector<PixelImage>& images, PixelImage& atlas, std::vector<sf::IntRect>& rects) {
+    const unsigned padding = 2;
+    const unsigned maxSize = sf::Texture::getMaximumSize();
+
+    std::vector<size_t> order(images.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        order[k] = k;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return images[a].height > images[b].height;
+    });
+
+    rects.assign(images.size(), sf::IntRect());
+    unsigned x = 0, y = 0, shelfHeight = 0, width = 0;
+    for (size_t k : order) {
+        if (x > 0 && x + images[k].width > maxSize) {
+            x = 0;
+            y += shelfHeight + padding;
+            shelfHeight = 0;
+        }
+        rects[k] = sf::IntRect(static_cast<int>(x), static_cast<int>(y), static_cast<int>(images[k].width), static_cast<int>(images[k].height));
+        x += images[k].width + padding;
+        shelfHeight = std::max(shelfHeight, images[k].height);
+        width = std::max(width, x);
+    }
+    unsigned height = y + shelfHeight;
+    if (width > maxSize || height > maxSize) {
+        std::cerr << "Erreur : les images des usagers ne tiennent pas dans une texture de " << maxSize << " pixels !" << std::endl;
+        return false;
+    }
+
+    atlas.width = width;
+    atlas.height = height;
+    atlas.pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    for (size_t k = 0; k < images.size(); ++k) {
+        for (unsigned row = 0; row < images[k].height; ++row) {
+            std::memcpy(&atlas.pixels[((static_cast<size_t>(rects[k].top) + row) * width + rects[k].left) * 4],
+                        &images[k].pixels[static_cast<size_t>(row) * images[k].width * 4], static_cast<size_t>(images[k].width) * 4);
+        }
+    }
+    return true;
+}
+
+// Images prêtes à l'envoi : fond à la taille de la fenêtre et atlas des sprites (un rectangle par
+// image de la table de géométrie, repérée par son nom de fichier)
+struct AssetData {
+    PixelImage background;
+    PixelImage atlas;
+    std::vector<std::string> spriteNames;
+    std::vector<sf::IntRect> spriteRects;
+};
+
+// Décode et met à l'échelle une image sur un thread de travail (image vide en cas d'échec)
+std::future<PixelImage> decodeAsync(const std::string& path, unsigned width, unsigned height) {
+    return std::async(std::launch::async, [path, width, height] {
+        sf::Image source;
+        if (!source.loadFromFile(path)) {
+            std::cerr << "Erreur : Impossible de charger l'image " << path << " !" << std::endl;
+            return PixelImage();
+        }
+        return scaleImage(source, width, height);
+    });
+}
+
+// Décodages en cours des images sources de la table de géométrie (une tâche par image)
+struct AssetDecodes {
+    std::future<PixelImage> background;
+    std::vector<std::string> spriteNames;
+    std::vector<std::future<PixelImage>> sprites;
+};
+
+AssetDecodes startAssetDecodes(const GeometryTable& geometry, const std::string& imageDir) {
+    AssetDecodes decodes;
+    decodes.background = decodeAsync(imageDir + "background.jpg", WINDOW_WIDTH, WINDOW_HEIGHT);
+    for (const KindGeometry& kind : geometry.kinds) {
+        if (std::find(decodes.spriteNames.begin(), decodes.spriteNames.end(), kind.texture) != decodes.spriteNames.end()) {
+            continue;
+        }
+        decodes.spriteNames.push_back(kind.texture);
+        decodes.sprites.push_back(decodeAsync(imageDir + kind.texture, static_cast<unsigned>(kind.width) * SPRITE_SCALE, static_cast<unsigned>(kind.height) * SPRITE_SCALE));
+    }
+    return decodes;
+}
+
+// Décode les images sources de imageDir (en parallèle), les met à l'échelle et construit l'atlas
+bool prepareAssets(const GeometryTable& geometry, const std::string& imageDir, AssetData& data) {
+    AssetDecodes decodes = startAssetDecodes(geometry, imageDir);
+    data.background = decodes.background.get();
+    bool ok = data.background.width > 0;
+    std::vector<PixelImage> sprites;
+    for (std::future<PixelImage>& sprite : decodes.sprites) {
+        sprites.push_back(sprite.get());
+        ok = ok && sprites.back().width > 0;
+    }
+    data.spriteNames = decodes.spriteNames;
+    return ok && packAtlas(sprites, data.atlas, data.spriteRects);
+}
+
+// Paquet d'images (.pack) : un seul fichier binaire, projeté en mémoire au démarrage et envoyé tel
+// quel à la carte graphique, sans décodage ni mise à l'échelle. Entiers 32 bits little-endian :
+//   en-tête   magic "TLPK", version, nombre de pages, nombre de sprites
+//   pages     nom (32 octets), largeur, hauteur, position des pixels dans le fichier
+//   sprites   nom (32 octets), page, x, y, largeur, hauteur
+//   pixels    RGBA prémultiplié de chaque page, alignés sur 16 octets
+const std::uint32_t PACK_MAGIC = 0x4B504C54; // "TLPK"
+const std::uint32_t PACK_VERSION = 1;
+const size_t PACK_NAME_SIZE = 32;
+
+struct PackHeader {
+    std::uint32_t magic, version, pageCount, spriteCount;
+};
+
+struct PackPage {
+    char name[PACK_NAME_SIZE];
+    std::uint32_t width, height, offset;
+};
+
+struct PackSprite {
+    char name[PACK_NAME_SIZE];
+    std::uint32_t page, x, y, width, height;
+};
+
+bool writeAssetPack(const std::string& path, const AssetData& data) {
+    const PixelImage* images[2] = { &data.background, &data.atlas };
+    const char* pageNames[2] = { "background", "atlas" };
+
+    PackHeader header = { PACK_MAGIC, PACK_VERSION, 2, static_cast<std::uint32_t>(data.spriteNames.size()) };
+    size_t offset = sizeof(PackHeader) + 2 * sizeof(PackPage) + data.spriteNames.size() * sizeof(PackSprite);
+    std::vector<PackPage> pages(2);
+    for (int p = 0; p < 2; ++p) {
+        offset = (offset + 15) & ~size_t(15);
+        PackPage& page = pages[p];
+        std::memset(&page, 0, sizeof(page));
+        std::strncpy(page.name, pageNames[p], PACK_NAME_SIZE - 1);
+        page.width = images[p]->width;
+        page.height = images[p]->height;
+        page.offset = static_cast<std::uint32_t>(offset);
+        offset += images[p]->pixels.size();
+    }
+
+    std::vector<PackSprite> sprites(data.spriteNames.size());
+    for (size_t k = 0; k < sprites.size(); ++k) {
+        std::memset(&sprites[k], 0, sizeof(PackSprite));
+        if (data.spriteNames[k].size() >= PACK_NAME_SIZE) {
+            std::cerr << "Erreur : nom d'image trop long pour le paquet : " << data.spriteNames[k] << " !" << std::endl;
+            return false;
+        }
+        std::strncpy(sprites[k].name, data.spriteNames[k].c_str(), PACK_NAME_SIZE - 1);
+        const sf::IntRect& rect = data.spriteRects[k];
+        sprites[k].page = 1;
+        sprites[k].x = static_cast<std::uint32_t>(rect.left);
+        sprites[k].y = static_cast<std::uint32_t>(rect.top);
+        sprites[k].width = static_cast<std::uint32_t>(rect.width);
+        sprites[k].height = static_cast<std::uint32_t>(rect.height);
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Erreur : Impossible d'écrire le paquet d'images " << path << " !" << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(pages.data()), pages.size() * sizeof(PackPage));
+    out.write(reinterpret_cast<const char*>(sprites.data()), sprites.size() * sizeof(PackSprite));
+    for (int p = 0; p < 2; ++p) {
+        while (static_cast<size_t>(out.tellp()) < pages[p].offset) {
+            out.put(0);
+        }
+        out.write(reinterpret_cast<const char*>(images[p]->pixels.data()), images[p]->pixels.size());
+    }
+    return static_cast<bool>(out);
+}
+
+// Fichier projeté en mémoire en lecture seule
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (bytes) munmap(const_cast<std::uint8_t*>(bytes), length);
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER fileSize;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        bytes = mapping ? static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        length = static_cast<size_t>(fileSize.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        bytes = view == MAP_FAILED ? nullptr : static_cast<const std::uint8_t*>(view);
+#endif
+        return bytes != nullptr;
+    }
+
+    const std::uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    const std::uint8_t* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Atlas des usagers : les images de tous les types dans une seule texture
+struct TextureAtlas {
+    sf::Texture texture;
+    std::vector<sf::IntRect> rects;     // Rectangle de chaque type dans la texture
+};
+
+// Textures du programme, aux couleurs prémultipliées (à dessiner avec PREMULTIPLIED_ALPHA)
+struct Assets {
+    sf::Texture background;
+    TextureAtlas agents;
+};
+
+const sf::BlendMode PREMULTIPLIED_ALPHA(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha);
+
+bool uploadTexture(sf::Texture& texture, unsigned width, unsigned height, const std::uint8_t* pixels) {
+    if (!texture.create(width, height)) {
+        return false;
+    }
+    texture.update(pixels);
+    texture.setSmooth(true);
+    texture.generateMipmap();
+    return true;
+}
+
+// Associe à chaque type le rectangle de son image dans l'atlas. En cas d'échec l'atlas reste vide :
+// AgentRenderer attend alors l'atlas de repli au lieu de lire des rectangles manquants.
+bool assignSpriteRects(const GeometryTable& geometry, const std::vector<std::string>& names, const std::vector<sf::IntRect>& rects, TextureAtlas& atlas) {
+    atlas.rects.clear();
+    std::vector<sf::IntRect> kindRects;
+    for (const KindGeometry& kind : geometry.kinds) {
+        auto found = std::find(names.begin(), names.end(), kind.texture);
+        if (found == names.end()) {
+            std::cerr << "Erreur : l'image " << kind.texture << " (" << kind.name << ") manque dans le paquet !" << std::endl;
+            return false;
+        }
+        kindRects.push_back(rects[found - names.begin()]);
+    }
+    atlas.rects = std::move(kindRects);
+    return true;
+}
+
+// Chargement des images sources sans bloquer la fenêtre : les images sont décodées en parallèle
+// (startAssetDecodes) et le thread de la fenêtre, seul à créer les textures, envoie chacune à la
+// carte graphique dès qu'elle est prête. La fenêtre s'affiche tout de suite et le chargement dure
+// autant que la plus grosse image au lieu de la somme de toutes.
+class AssetLoader {
+public:
+    AssetLoader(const GeometryTable& geometry, const std::string& imageDir)
+        : geometry(geometry), decodes(startAssetDecodes(geometry, imageDir)), sprites(decodes.sprites.size()) {}
+
+    bool pending() const { return !backgroundDone || !agentsDone; }
+
+    // Envoie les images décodées depuis le dernier appel (l'atlas quand tous les sprites sont là).
+    // Retourne faux si une image n'a pas pu être chargée.
+    bool poll(Assets& assets) {
+        if (!backgroundDone && isReady(decodes.background)) {
+            PixelImage image = decodes.background.get();
+            if (image.width == 0 || !uploadTexture(assets.background, image.width, image.height, image.pixels.data())) {
+                return false;
+            }
+            backgroundDone = true;
+        }
+
+        for (size_t k = 0; k < decodes.sprites.size(); ++k) {
+            if (decodes.sprites[k].valid() && isReady(decodes.sprites[k])) {
+                sprites[k] = decodes.sprites[k].get();
+                if (sprites[k].width == 0) {
+                    return false;
+                }
+                ++spritesDecoded;
+            }
+        }
+        if (!agentsDone && spritesDecoded == sprites.size()) {
+            PixelImage atlas;
+            std::vector<sf::IntRect> rects;
+            if (!packAtlas(sprites, atlas, rects) || !uploadTexture(assets.agents.texture, atlas.width, atlas.height, atlas.pixels.data()) ||
+                !assignSpriteRects(geometry, decodes.spriteNames, rects, assets.agents)) {
+                return false;
+            }
+            agentsDone = true;
+            sprites.clear();
+        }
+        return true;
+    }
+
+private:
+    const GeometryTable& geometry;
+    AssetDecodes decodes;
+    std::vector<PixelImage> sprites;    // Sprites décodés, en attente des autres pour l'atlas
+    size_t spritesDecoded = 0;
+    bool backgroundDone = false;
+    bool agentsDone = false;
+
+    static bool isReady(const std::future<PixelImage>& decode) {
+        return decode.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+};
+
+// Charge un paquet d'images : projection en mémoire puis envoi direct des pixels
+bool loadAssetPack(const std::string& path, const GeometryTable& geometry, Assets& assets) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    const std::uint8_t* bytes = file.data();
+    PackHeader header;
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    size_t tableEnd = sizeof(header) + size_t(header.pageCount) * sizeof(PackPage) + size_t(header.spriteCount) * sizeof(PackSprite);
+    if (header.magic != PACK_MAGIC || header.version != PACK_VERSION || header.pageCount != 2 || file.size() < tableEnd) {
+        std::cerr << "Erreur : " << path << " n'est pas un paquet d'images valide !" << std::endl;
+        return false;
+    }
+
+    PackPage pages[2];
+    std::memcpy(pages, bytes + sizeof(header), sizeof(pages));
+    sf::Texture* textures[2] = { &assets.background, &assets.agents.texture };
+    for (int p = 0; p < 2; ++p) {
+        if (size_t(pages[p].offset) + size_t(pages[p].width) * pages[p].height * 4 > file.size() ||
+            !uploadTexture(*textures[p], pages[p].width, pages[p].height, bytes + pages[p].offset)) {
+            std::cerr << "Erreur : page " << p << " invalide dans " << path << " !" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::string> names;
+    std::vector<sf::IntRect> rects;
+    for (std::uint32_t k = 0; k < header.spriteCount; ++k) {
+        PackSprite sprite;
+        std::memcpy(&sprite, bytes + sizeof(header) + sizeof(pages) + k * sizeof(PackSprite), sizeof(sprite));
+        names.emplace_back(sprite.name, strnlen(sprite.name, PACK_NAME_SIZE));
+        rects.emplace_back(static_cast<int>(sprite.x), static_cast<int>(sprite.y), static_cast<int>(sprite.width), static_cast<int>(sprite.height));
+    }
+    return assignSpriteRects(geometry, names, rects, assets.agents);
+}
+
+
+// Affichage des usagers en un seul lot : les quadrilatères de tous les usagers sont écrits dans
+// un sf::VertexArray dessiné en un appel avec la texture de l'atlas (un seul changement de texture).
+// Un usager coûte quatre sommets au lieu d'un appel de dessin.
+class AgentRenderer {
+public:
+    AgentRenderer(const GeometryTable& geometry, const TextureAtlas& atlas) : atlas(atlas), batch(sf::Quads) {
+        for (const KindGeometry& kind : geometry.kinds) {
+            sizes.push_back(sf::Vector2f(kind.width, kind.height));
+        }
+    }
+
+    void draw(sf::RenderWindow& window, const WorldFrame& frame) {
+        if (atlas.rects.size() != sizes.size()) {
+            return; // Atlas pas encore chargé (un rectangle par type)
+        }
+
+        batch.clear(); // Garde la mémoire des images précédentes
+        for (size_t i = 0; i < frame.size(); ++i) {
+            std::uint8_t kind = frame.kind[i];
+            sf::Vector2f size = sizes[kind];
+            sf::FloatRect rect(atlas.rects[kind]);
+            // Coins du sprite dans son repère (le long du cap, vers la droite du cap) et dans l'atlas
+            const sf::Vector2f local[4] = { { 0, 0 }, { size.x, 0 }, { size.x, size.y }, { 0, size.y } };
+            const sf::Vector2f uv[4] = {
+                { rect.left, rect.top }, { rect.left + rect.width, rect.top },
+                { rect.left + rect.width, rect.top + rect.height }, { rect.left, rect.top + rect.height }
+            };
+            for (int c = 0; c < 4; ++c) {
+                batch.append(sf::Vertex(corner(frame.posX[i], frame.posY[i], frame.heading[i], local[c]), uv[c]));
+            }
+        }
+
+        if (batch.getVertexCount() > 0) {
+            sf::RenderStates states(&atlas.texture);
+            states.blendMode = PREMULTIPLIED_ALPHA;
+            window.draw(batch, states);
+        }
+    }
+
+private:
+    const TextureAtlas& atlas;
+    std::vector<sf::Vector2f> sizes;            // Taille affichée de chaque type
+    sf::VertexArray batch;
+
+    // Position d'un coin après rotation du sprite selon le cap (0, 180, 90 ou 270 degrés)
+    static sf::Vector2f corner(float x, float y, std::uint8_t heading, sf::Vector2f local) {
+        switch (heading) {
+        case HeadingEast:
+            return sf::Vector2f(x + local.x, y + local.y);
+        case HeadingWest:
+            return sf::Vector2f(x - local.x, y - local.y);
+        case HeadingSouth:
+            return sf::Vector2f(x - local.y, y + local.x);
+        default:
+            return sf::Vector2f(x + local.y, y - local.x);
+        }
+    }
+};
+
+
+// Usager à faire apparaître
+struct SpawnRequest {
+    std::uint8_t kind;
+    std::uint8_t heading;
+    std::uint8_t turnFlags;
+};
+
+// Générateur à compteur Philox4x32-10 : un tirage est une fonction pure de la graine et d'un compteur
+// de 128 bits, sans état partagé. Chaque flux numérote ses tirages lui-même, donc le résultat ne
+// dépend ni du nombre de threads ni de l'ordre dans lequel les carrefours sont traités.
+using RandomBlock = std::array<std::uint32_t, 4>;
+
+RandomBlock philox(std::uint64_t seed, RandomBlock counter) {
+    std::uint32_t key0 = static_cast<std::uint32_t>(seed);
+    std::uint32_t key1 = static_cast<std::uint32_t>(seed >> 32);
+    for (int round = 0; round < 10; ++round) {
+        if (round > 0) {
+            key0 += 0x9E3779B9u;
+            key1 += 0xBB67AE85u;
+        }
+        std::uint64_t product0 = static_cast<std::uint64_t>(0xD2511F53u) * counter[0];
+        std::uint64_t product1 = static_cast<std::uint64_t>(0xCD9E8D57u) * counter[2];
+        counter = { static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key0, static_cast<std::uint32_t>(product1),
+                    static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key1, static_cast<std::uint32_t>(product0) };
+    }
+    return counter;
+}
+
+// Usage d'un tirage, placé dans le premier mot du compteur pour séparer les flux
+enum RandomPurpose : std::uint32_t {
+    RandomArrival = 1,  // Arrivée candidate d'un flux d'entrée
+    RandomHandoff = 2   // Virage d'un usager passé au carrefour voisin
+};
+
+// Réel uniforme dans [0, 1) sur 53 bits
+double uniformFromBits(std::uint32_t high, std::uint32_t low) {
+    return static_cast<double>((static_cast<std::uint64_t>(high) << 21) ^ (low >> 11)) * 0x1.0p-53;
+}
+
+// Graine tirée au hasard quand aucune n'est imposée
+std::uint64_t randomSeed() {
+    std::random_device rd;
+    return (static_cast<std::uint64_t>(rd()) << 32) | rd();
+}
+
+// Choisit le virage d'un usager au prochain carrefour (tout droit, gauche ou droite) à partir d'un mot aléatoire
+std::uint8_t generateRandomTurn(std::uint32_t bits) {
+    int turnDecision = static_cast<int>((static_cast<std::uint64_t>(bits) * 3) >> 32);
+    return turnDecision == 1 ? FlagTurnLeft : (turnDecision == 2 ? FlagTurnRight : 0);
+}
+
+// Délai (secondes) avant la prochaine arrivée d'un processus de Poisson de débit rate (par seconde), u uniforme dans [0, 1)
+double generateInterArrival(double rate, double u) {
+    return -std::log1p(-u) / rate;
+}
+
+// Indique si une arrivée candidate est gardée (probabilité p), à partir d'un mot aléatoire
+bool generateAcceptance(double p, std::uint32_t bits) {
+    return bits * 0x1.0p-32 < p;
+}
+
+
+// Plan de feux : durée de chaque phase (en secondes), dans l'ordre du cycle
+// RedHorizontal, GreenHorizontal, OrangeHorizontal, RedHorizontalOrangeVertical
+struct SignalPlan {
+    float red = 5;
+    float green = 30;
+    float orange = 5;
+    float redOrangeVertical = 30;
+
+    float phaseDuration(TrafficLightState state) const {
+        switch (state) {
+        case RedHorizontal:
+            return red;
+        case GreenHorizontal:
+            return green;
+        case OrangeHorizontal:
+            return orange;
+        case RedHorizontalOrangeVertical:
+            return redOrangeVertical;
+        }
+        return redOrangeVertical;
+    }
+};
+
+// Lit un plan écrit "rouge,vert,orange,rouge-orange vertical" ; faux si une durée manque ou n'est pas positive
+bool parseSignalPlan(const std::string& text, SignalPlan& plan) {
+    std::istringstream in(text);
+    float* durations[4] = { &plan.red, &plan.green, &plan.orange, &plan.redOrangeVertical };
+    for (int k = 0; k < 4; ++k) {
+        char separator = ',';
+        if ((k > 0 && !(in >> separator)) || separator != ',' || !(in >> *durations[k]) || *durations[k] <= 0) {
+            return false;
+        }
+    }
+    return in.peek() == std::char_traits<char>::eof();
+}
+
+std::string formatSignalPlan(const SignalPlan& plan) {
+    std::ostringstream out;
+    out << plan.red << "," << plan.green << "," << plan.orange << "," << plan.redOrangeVertical;
+    return out.str();
+}
+
+// Usager qui quitte une tuile par un bord et rejoint la tuile voisine
+struct Transfer {
+    std::uint32_t target;   // Indice de la tuile d'arrivée
+    SpawnRequest request;   // Entre par le point d'apparition de son cap
+};
+
+// File d'attente d'une voie à l'entrée d'une tuile (arrivées et usagers venus d'une tuile voisine).
+// Retrait en tête par un indice : pas de deque par voie, et la mémoire est compactée de temps en temps.
+struct EntryQueue {
+    std::vector<SpawnRequest> items;
+    size_t head = 0;
+
+    size_t size() const { return items.size() - head; }
+    bool empty() const { return head == items.size(); }
+    const SpawnRequest& front() const { return items[head]; }
+
+    void popFront() {
+        ++head;
+        if (head == items.size()) {
+            items.clear();
+            head = 0;
+        }
+        else if (head >= 64 && head * 2 >= items.size()) {
+            items.erase(items.begin(), items.begin() + static_cast<std::ptrdiff_t>(head));
+            head = 0;
+        }
+    }
+};
+
+// Mesures d'une approche du carrefour (tous types d'usagers) pendant la phase de feu en cours
+struct ApproachCounters {
+    std::uint32_t discharged = 0;   // Usagers entrés dans le carrefour (dernière ligne d'arrêt franchie)
+    std::uint32_t queued = 0;       // Usagers arrêtés avant leur ligne d'arrêt au dernier pas
+    std::uint32_t maxQueued = 0;    // Plus longue file de la phase
+    float maxDelay = 0;             // Plus grand retard d'un usager entré dans le carrefour (s)
+    double delay = 0;               // Retard cumulé des usagers entrés dans le carrefour (s)
+};
+
+// Mesures d'une approche pour une phase de feu terminée
+struct PhaseMetrics {
+    std::uint32_t tile;
+    std::uint8_t heading;
+    std::uint8_t state;             // Phase terminée (TrafficLightState)
+    double start, end;              // Début et fin de la phase (secondes simulées)
+    ApproachCounters counters;
+};
+
+// Tuile du réseau : un carrefour de la carte 800x600 avec son propre feu, ses usagers et ses voies.
+// Toutes les tuiles partagent la table de géométrie. Pendant un pas, une tuile ne touche qu'à ses
+// propres données : les usagers qui sortent par un bord sont placés dans outbox, puis la
+// simulation les transfère dans la file d'entrée (inbox) de la tuile voisine une fois toutes les
+// tuiles avancées. Les arrivées dans le réseau passent par les mêmes files.
+struct Intersection {
+    TrafficLight trafficLight;
+    AgentStore agents;
+    LaneQueues lanes;
+    SpatialHash spatialHash;
+    int column, row;                    // Position dans la grille du réseau
+
+    std::vector<EntryQueue> inbox;      // Par voie : usagers en attente de place au point d'apparition
+    std::vector<Transfer> outbox;       // Usagers partis vers une tuile voisine pendant le pas
+    std::vector<std::uint32_t> events;  // Usagers signalés par le noyau de déplacement (réutilisé à chaque pas)
+
+    std::vector<int> exitedByType;      // Usagers sortis du réseau (et libérés) par type
+    int handoffs = 0;                   // Usagers transmis à une tuile voisine
+    int lightChanges = 0;
+    int conflicts = 0;                  // Voir SpatialHash::markConflicts
+    std::array<ApproachCounters, HEADING_COUNT> approaches; // Mesures de la phase en cours, par cap
+    double phaseStart = 0;              // Début de la phase en cours
+
+    Intersection(const GeometryTable& geometry, int column, int row)
+        : spatialHash(geometry), column(column), row(row), exitedByType(geometry.kinds.size()) {
+        lanes.lanes.resize(geometry.kinds.size() * HEADING_COUNT);
+        inbox.resize(geometry.kinds.size() * HEADING_COUNT);
+    }
+
+    void enqueue(const SpawnRequest& request) {
+        inbox[laneOf(request.kind, request.heading)].items.push_back(request);
+    }
+
+    // Fait entrer les usagers en attente, dans l'ordre de chaque voie, tant que leur voie a de la place
+    void admitWaiting(const GeometryTable& geometry, long long tick) {
+        for (EntryQueue& queue : inbox) {
+            while (!queue.empty() && tryAdmit(queue.front(), geometry, tick)) {
+                queue.popFront();
+            }
+        }
+    }
+
+    // Termine les mesures de la phase en cours à l'instant time (ajoutées à records s'il est fourni)
+    void closePhase(std::uint32_t tileIndex, double time, std::vector<PhaseMetrics>* records) {
+        for (std::uint8_t heading = 0; heading < HEADING_COUNT; ++heading) {
+            ApproachCounters& counters = approaches[heading];
+            if (records) {
+                records->push_back({ tileIndex, heading, static_cast<std::uint8_t>(trafficLight.getState()), phaseStart, time, counters });
+            }
+            counters.discharged = 0;
+            counters.maxQueued = counters.queued;
+            counters.maxDelay = 0;
+            counters.delay = 0;
+        }
+        phaseStart = time;
+    }
+
+    size_t waitingCount() const {
+        size_t count = 0;
+        for (const EntryQueue& queue : inbox) {
+            count += queue.size();
+        }
+        return count;
+    }
+
+    // Ajoute l'usager en queue de sa voie, sauf si la queue de la file n'a pas encore libéré
+    // le point d'apparition. Retourne vrai si l'usager a été ajouté.
+    bool tryAdmit(const SpawnRequest& request, const GeometryTable& geometry, long long tick) {
+        const KindGeometry& kind = geometry.kinds[request.kind];
+        std::uint8_t lane = laneOf(request.kind, request.heading);
+        if (!lanes.lanes[lane].empty()) {
+            float tailS = pathPosition(agents, agents.row(lanes.lanes[lane].back()));
+            if (tailS - spawnPosition(kind, request.heading) < (kind.length() + kind.minGap) * PIXELS_PER_METER) {
+                return false;
+            }
+        }
+        size_t i = spawnAgent(agents, geometry, request.kind, request.heading, request.turnFlags);
+        agents.entryTick[i] = static_cast<std::uint32_t>(tick);
+        lanes.pushBack(lane, agents.id[i]);
+        return true;
+    }
+
+    // Tuile voisine dans la direction du cap dans une grille gridColumns x gridRows, -1 si l'usager quitte le réseau
+    int neighbour(std::uint8_t heading, int gridColumns, int gridRows) const {
+        int c = column + (heading == HeadingEast ? 1 : heading == HeadingWest ? -1 : 0);
+        int r = row + (heading == HeadingSouth ? 1 : heading == HeadingNorth ? -1 : 0);
+        if (c < 0 || c >= gridColumns || r < 0 || r >= gridRows) {
+            return -1;
+        }
+        return r * gridColumns + c;
+    }
+
+    // Avance la tuile d'un pas (tick : numéro du pas) ; ne modifie que ses propres données
+    void step(const GeometryTable& geometry, float dt, long long tick, int gridColumns, int gridRows) {
+        // Arrivées (réseau et tuiles voisines) ; celles dont la voie est pleine attendent
+        admitWaiting(geometry, tick);
+        // Tuile vide : les files mesurées au dernier pas sont déjà nulles (un usager arrêté ne quitte pas
+        // la tuile dans le pas où il est compté) ; ne pas toucher aux mesures garde ce cas sans coût
+        if (agents.size() == 0) {
+            return;
+        }
+
+        // Déplacement de tous les usagers par le noyau vectoriel, puis traitement des rares
+        // usagers signalés (virage, ligne d'arrêt dépassée, sortie de la carte)
+        float redMask[MAX_SIGNAL_GROUPS];
+        redMasksByGroup(trafficLight.getState(), redMask);
+        events.clear();
+        std::uint32_t queued[HEADING_COUNT] = {};
+        followLeaders(agents, lanes, geometry, redMask, dt, queued);
+        updateQueues(queued);
+        stepAgents(agents, redMask, dt, events);
+
+        // Ordre décroissant : le dernier usager qui remplace un usager retiré a déjà été traité
+        for (auto it = events.rbegin(); it != events.rend(); ++it) {
+            size_t i = *it;
+            // Un usager qui n'a pas encore tourné et franchit sa dernière ligne d'arrêt entre dans le carrefour
+            bool approaching = !(agents.flags[i] & FlagTurned) && std::isfinite(agents.stopS[i]);
+            if (applyAgentEvent(agents, i, geometry, lanes)) {
+                int target = neighbour(agents.heading[i], gridColumns, gridRows);
+                if (target < 0) {
+                    ++exitedByType[agents.kind[i]];
+                }
+                else {
+                    outbox.push_back({ static_cast<std::uint32_t>(target), { agents.kind[i], agents.heading[i], 0 } });
+                    ++handoffs;
+                }
+                lanes.remove(agents.lane[i], agents.id[i]);
+                spatialHash.remove(agents, i);
+                agents.remove(i);
+            }
+            else if (approaching && !(agents.flags[i] & FlagTurned) && !std::isfinite(agents.stopS[i])) {
+                // Retard : temps passé dans la tuile moins le temps du même trajet à la vitesse de croisière
+                const KindGeometry& kind = geometry.kinds[agents.kind[i]];
+                float travelled = (pathPosition(agents, i) - spawnPosition(kind, agents.heading[i])) / PIXELS_PER_METER;
+                float delay = std::max(0.0f, static_cast<std::uint32_t>(tick - agents.entryTick[i]) * dt - travelled / kind.speed);
+                ApproachCounters& counters = approaches[agents.heading[i]];
+                ++counters.discharged;
+                counters.delay += delay;
+                counters.maxDelay = std::max(counters.maxDelay, delay);
+            }
+        }
+
+        // Détection des conflits dans le carrefour (usagers qui tournent à travers les autres voies)
+        spatialHash.update(agents, geometry);
+        conflicts += spatialHash.markConflicts(agents, geometry);
+    }
+
+    void updateQueues(const std::uint32_t queued[HEADING_COUNT]) {
+        for (int heading = 0; heading < HEADING_COUNT; ++heading) {
+            approaches[heading].queued = queued[heading];
+            approaches[heading].maxQueued = std::max(approaches[heading].maxQueued, queued[heading]);
+        }
+    }
+};
+
+// Échéancier hiérarchique (timing wheel) des changements de feux, en ticks de durée resolution
+// sur l'horloge simulée. Le niveau l compte 256 cases de 256^l ticks : un événement est rangé au
+// niveau le plus fin qui couvre son échéance, puis redescend d'un niveau à chaque fois que
+// l'horloge atteint sa case. Ajouter ou déclencher un événement coûte O(1), et un feu ne coûte
+// rien entre deux changements, quel que soit le nombre de carrefours.
+class TimingWheel {
+public:
+    struct TimerEvent {
+        std::uint64_t due;      // Tick d'échéance
+        std::uint32_t target;   // Carrefour concerné
+    };
+
+    explicit TimingWheel(double resolution) : resolution(resolution) {}
+
+    std::uint64_t now() const { return currentTick; }
+
+    // Nombre de ticks (au moins un) correspondant à une durée simulée
+    std::uint64_t ticksFor(double seconds) const {
+        return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::llround(seconds / resolution)));
+    }
+
+    // Premier tick atteint ou dépassé à l'instant time
+    std::uint64_t tickAt(double time) const {
+        return static_cast<std::uint64_t>(std::max(0.0, std::ceil(time / resolution - TICK_EPSILON)));
+    }
+
+    void schedule(std::uint64_t due, std::uint32_t target) {
+        insert({ std::max(due, currentTick), target });
+    }
+
+    // Événements en attente, par échéance croissante (sauvegarde)
+    std::vector<TimerEvent> pending() const {
+        std::vector<TimerEvent> events;
+        for (const auto& level : slots) {
+            for (const std::vector<TimerEvent>& slot : level) {
+                events.insert(events.end(), slot.begin(), slot.end());
+            }
+        }
+        std::stable_sort(events.begin(), events.end(), [](const TimerEvent& a, const TimerEvent& b) { return a.due < b.due; });
+        return events;
+    }
+
+    // Repart du tick tick avec les événements donnés (restauration)
+    void restore(std::uint64_t tick, const std::vector<TimerEvent>& events) {
+        for (auto& level : slots) {
+            for (std::vector<TimerEvent>& slot : level) {
+                slot.clear();
+            }
+        }
+        currentTick = tick;
+        for (const TimerEvent& event : events) {
+            schedule(event.due, event.target);
+        }
+    }
+
+    // Avance l'horloge jusqu'au temps simulé time et appelle fire(event) pour chaque événement échu,
+    // dans l'ordre des échéances (puis d'ajout). fire peut reprogrammer des événements.
+    template <typename F>
+    void advance(double time, F fire) {
+        std::uint64_t target = static_cast<std::uint64_t>(time / resolution + TICK_EPSILON);
+        while (currentTick < target) {
+            ++currentTick;
+            // Redescend les cases des niveaux supérieurs atteintes, du plus grossier au plus fin
+            int top = 0;
+            while (top + 1 < LEVELS && (currentTick & ((std::uint64_t(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) {
+                ++top;
+            }
+            for (int level = top; level >= 1; --level) {
+                std::vector<TimerEvent> moved;
+                moved.swap(slots[level][slotIndex(currentTick, level)]);
+                for (const TimerEvent& event : moved) {
+                    insert(event);
+                }
+            }
+
+            std::vector<TimerEvent>& slot = slots[0][slotIndex(currentTick, 0)];
+            due.swap(slot);
+            for (const TimerEvent& event : due) {
+                fire(event);
+            }
+            due.clear();
+        }
+    }
+
+private:
+    static constexpr int LEVELS = 4;             // 2^32 ticks : plus d'un an à 120 ticks par seconde
+    static constexpr int SLOT_BITS = 8;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr double TICK_EPSILON = 1e-6; // Absorbe l'arrondi de l'accumulation des pas
+
+    double resolution;                           // Durée d'un tick (secondes)
+    std::uint64_t currentTick = 0;
+    std::vector<TimerEvent> slots[LEVELS][SLOTS];
+    std::vector<TimerEvent> due;                 // Événements de la case en cours (réutilisé)
+
+    static size_t slotIndex(std::uint64_t tick, int level) {
+        return static_cast<size_t>((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    }
+
+    void insert(const TimerEvent& event) {
+        std::uint64_t delta = event.due - currentTick;
+        int level = 0;
+        while (level + 1 < LEVELS && delta >= (std::uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+        slots[level][slotIndex(event.due, level)].push_back(event);
+    }
+};
+
+
+// Horloge virtuelle : seule source de temps de la simulation (feux, apparitions, déplacements).
+// Le temps simulé n'avance que par pas fixes de dt. En fenêtre, le temps réel de chaque image
+// est converti en nombre de pas selon l'état de l'horloge : en pause, en accéléré (timeScale)
+// ou pas à pas. Les cycles de feux et les apparitions restent donc cohérents entre eux quelle
+// que soit la vitesse d'affichage.
+class SimClock {
+public:
+    float dt;                   // Pas fixe (secondes simulées)
+    double time = 0;            // Temps simulé écoulé (secondes)
+    long long ticks = 0;        // Nombre de pas effectués
+
+    static constexpr double MIN_TIME_SCALE = 0.01;
+    static constexpr double MAX_TIME_SCALE = 1000;
+
+    explicit SimClock(float dt) : dt(dt) {}
+
+    // Appelé une fois par pas de simulation
+    void tick() {
+        time += dt;
+        ++ticks;
+    }
+
+    // Les commandes viennent du thread de la fenêtre, stepsForFrame du thread de simulation
+    bool isPaused() const { return paused.load(std::memory_order_relaxed); }
+    double timeScale() const { return scale.load(std::memory_order_relaxed); }
+
+    void togglePause() {
+        paused.store(!paused.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void setTimeScale(double newScale) {
+        scale.store(std::clamp(newScale, MIN_TIME_SCALE, MAX_TIME_SCALE), std::memory_order_relaxed);
+    }
+
+    // En pause, demande un pas unique à la prochaine image
+    void requestSingleStep() {
+        if (isPaused()) {
+            pendingSteps.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Nombre de pas à effectuer pour une durée réelle de realSeconds.
+    // La durée est bornée pour ne pas accumuler de retard après une interruption (fenêtre déplacée...).
+    long long stepsForFrame(float realSeconds) {
+        if (isPaused()) {
+            accumulator = 0;
+            return pendingSteps.exchange(0, std::memory_order_relaxed);
+        }
+        accumulator += std::min(realSeconds, 0.25f) * timeScale();
+        long long steps = static_cast<long long>(accumulator / dt);
+        accumulator -= steps * static_cast<double>(dt);
+        return steps;
+    }
+
+    // Temps réel avant que le prochain pas soit dû (hors pause)
+    double secondsUntilNextStep() const {
+        return (dt - accumulator) / timeScale();
+    }
+
+private:
+    std::atomic<bool> paused{ false };
+    std::atomic<double> scale{ 1 };     // Secondes simulées par seconde réelle
+    std::atomic<long long> pendingSteps{ 0 };
+    double accumulator = 0;             // Temps simulé dû et pas encore effectué
+};
+
+
+// Pool de threads pour les pas parallèles. Les indices [0, count) sont découpés en paquets ; chaque
+// thread (le thread appelant compris) traite d'abord sa part contiguë de paquets, puis vole les
+// paquets restants dans la part des autres. Un paquet est pris par un simple fetch_add : ni verrou
+// ni file partagée pendant le pas, et les tuiles chargées n'attardent pas un seul thread.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threadCount) : parts(std::max(threadCount, 1u)) {
+        for (size_t w = 1; w < parts.size(); ++w) {
+            workers.emplace_back([this, w] { workerLoop(w); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t threadCount() const { return parts.size(); }
+
+    // Appelle task(begin, end) sur des paquets de chunkSize indices couvrant [0, count) et attend
+    // qu'ils soient tous traités. Un seul paquet est traité directement par le thread appelant.
+    template <typename F>
+    void parallelFor(size_t count, size_t chunkSize, F task) {
+        size_t chunks = (count + chunkSize - 1) / chunkSize;
+        if (chunks <= 1 || workers.empty()) {
+            if (count > 0) {
+                task(0, count);
+            }
+            return;
+        }
+
+        job = [&](size_t chunk) {
+            size_t begin = chunk * chunkSize;
+            task(begin, std::min(begin + chunkSize, count));
+        };
+        for (size_t w = 0; w < parts.size(); ++w) {
+            parts[w].next.store(chunks * w / parts.size(), std::memory_order_relaxed);
+            parts[w].end = chunks * (w + 1) / parts.size();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++generation;
+            busy = workers.size();
+        }
+        wake.notify_all();
+
+        runChunks(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+    }
+
+private:
+    // Part de paquets d'un thread ; une ligne de cache chacune pour éviter le faux partage
+    struct alignas(64) Part {
+        std::atomic<size_t> next{ 0 };
+        size_t end = 0;
+    };
+
+    std::vector<Part> parts;
+    std::vector<std::thread> workers;
+    std::function<void(size_t)> job;    // Paquet à traiter pendant le parallelFor en cours
+
+    std::mutex mutex;
+    std::condition_variable wake;       // Nouveau parallelFor ou arrêt
+    std::condition_variable done;       // Tous les threads ont fini leurs paquets
+    unsigned long long generation = 0;
+    size_t busy = 0;
+    bool stopping = false;
+
+    void runChunks(size_t self) {
+        for (size_t k = 0; k < parts.size(); ++k) {
+            Part& part = parts[(self + k) % parts.size()];
+            for (size_t chunk = part.next.fetch_add(1); chunk < part.end; chunk = part.next.fetch_add(1)) {
+                job(chunk);
+            }
+        }
+    }
+
+    void workerLoop(size_t self) {
+        unsigned long long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            runChunks(self);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+
+// Tampon d'octets des fichiers binaires : valeurs brutes, dans l'ordre d'octets de la machine
+struct ByteWriter {
+    std::vector<std::uint8_t> bytes;
+
+    template <typename T>
+    void put(const T& value) {
+        putArray(&value, 1);
+    }
+
+    template <typename T>
+    void putArray(const T* values, size_t count) {
+        const std::uint8_t* first = reinterpret_cast<const std::uint8_t*>(values);
+        bytes.insert(bytes.end(), first, first + count * sizeof(T));
+    }
+
+    // Complète à un multiple de 8 octets : les tableaux restent alignés dans le fichier projeté
+    void align() {
+        bytes.resize((bytes.size() + 7) & ~size_t(7), 0);
+    }
+};
+
+// Lecture bornée d'une zone d'octets (fichier projeté) ; les lectures échouent au-delà de size
+struct ByteReader {
+    const std::uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+
+    template <typename T>
+    bool get(T& value) {
+        if (size < offset || size - offset < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool getArray(std::vector<T>& values, size_t count) {
+        if (size < offset || count > (size - offset) / sizeof(T)) {
+            return false;
+        }
+        values.resize(count);
+        if (count > 0) {
+            std::memcpy(values.data(), data + offset, count * sizeof(T));
+        }
+        offset += count * sizeof(T);
+        return true;
+    }
+
+    void align() {
+        offset = (offset + 7) & ~size_t(7);
+    }
+};
+
+// État complet d'une tuile dans un fichier, de quoi la faire repartir exactement où elle en était :
+//   TileStateHeader, puis les mesures de la phase en cours par cap
+//   chaque tableau de AgentStore (agentCount valeurs), puis les identifiants libres
+//   pour chaque voie : nombre d'usagers sur la voie et en file d'entrée, puis leurs identifiants et requêtes
+//   usagers sortis par type
+// Chaque partie est alignée sur 8 octets.
+struct TileStateHeader {
+    double phaseStart;
+    std::uint32_t lightState;
+    std::uint32_t agentCount;
+    std::uint32_t idCount;          // Identifiants attribués, libres compris
+    std::uint32_t freeIdCount;
+    std::uint32_t laneCount;
+    std::int32_t handoffs, lightChanges, conflicts;
+};
+
+void writeTileState(ByteWriter& out, const Intersection& tile) {
+    const AgentStore& agents = tile.agents;
+    TileStateHeader header = { tile.phaseStart, static_cast<std::uint32_t>(tile.trafficLight.getState()), static_cast<std::uint32_t>(agents.size()),
+                               static_cast<std::uint32_t>(agents.rowOfId.size()), static_cast<std::uint32_t>(agents.freeIds.size()),
+                               static_cast<std::uint32_t>(tile.lanes.lanes.size()), tile.handoffs, tile.lightChanges, tile.conflicts };
+    out.put(header);
+    out.align();
+    out.putArray(tile.approaches.data(), tile.approaches.size());
+    agents.forEachColumn([&](const auto& column) {
+        out.putArray(column.data(), column.size());
+        out.align();
+    });
+    out.putArray(agents.freeIds.data(), agents.freeIds.size());
+    out.align();
+    for (size_t lane = 0; lane < tile.lanes.lanes.size(); ++lane) {
+        const std::vector<std::uint32_t>& queue = tile.lanes.lanes[lane];
+        const EntryQueue& waiting = tile.inbox[lane];
+        std::uint32_t counts[2] = { static_cast<std::uint32_t>(queue.size()), static_cast<std::uint32_t>(waiting.size()) };
+        out.put(counts);
+        out.putArray(queue.data(), queue.size());
+        out.putArray(waiting.items.data() + waiting.head, waiting.size());
+        out.align();
+    }
+    out.putArray(tile.exitedByType.data(), tile.exitedByType.size());
+    out.align();
+}
+
+// Remplace l'état de la tuile par celui écrit par writeTileState ; faux si les données sont invalides.
+// Chaque valeur qui sert d'indice (type, cap, voie, groupe de feux, case, identifiant) est vérifiée :
+// un fichier abîmé ou pris avec une autre géométrie est refusé au lieu de lire hors des tableaux.
+bool readTileState(ByteReader& in, Intersection& tile) {
+    TileStateHeader header;
+    if (!in.get(header) || header.lightState > RedHorizontalOrangeVertical || header.laneCount != tile.lanes.lanes.size()) {
+        return false;
+    }
+    in.align();
+    std::vector<ApproachCounters> approaches;
+    if (!in.getArray(approaches, HEADING_COUNT)) {
+        return false;
+    }
+    std::copy(approaches.begin(), approaches.end(), tile.approaches.begin());
+    AgentStore& agents = tile.agents;
+    bool valid = true;
+    agents.forEachColumn([&](auto& column) {
+        valid = valid && in.getArray(column, header.agentCount);
+        in.align();
+    });
+    valid = valid && in.getArray(agents.freeIds, header.freeIdCount);
+    in.align();
+    auto validId = [&](std::uint32_t agentId) { return agentId < header.idCount; };
+    if (!valid || !std::all_of(agents.id.begin(), agents.id.end(), validId) || !std::all_of(agents.freeIds.begin(), agents.freeIds.end(), validId)) {
+        return false;
+    }
+    size_t kindCount = tile.exitedByType.size();
+    size_t cellCount = tile.spatialHash.cellCount();
+    for (size_t i = 0; i < agents.size(); ++i) {
+        if (agents.kind[i] >= kindCount || agents.heading[i] >= HEADING_COUNT || agents.lane[i] != laneOf(agents.kind[i], agents.heading[i]) ||
+            agents.signalGroup[i] >= MAX_SIGNAL_GROUPS || (agents.cell[i] != AgentStore::NO_CELL && agents.cell[i] >= cellCount)) {
+            return false;
+        }
+    }
+    agents.rebuildRows(header.idCount);
+
+    for (size_t lane = 0; lane < header.laneCount; ++lane) {
+        std::uint32_t counts[2];
+        EntryQueue& waiting = tile.inbox[lane];
+        waiting.head = 0;
+        // Les files ne contiennent que des usagers présents de la voie, et des arrivées de cette voie
+        auto validMember = [&](std::uint32_t agentId) {
+            return validId(agentId) && agents.rowOfId[agentId] != AgentStore::NO_ROW && agents.lane[agents.row(agentId)] == lane;
+        };
+        auto validRequest = [&](const SpawnRequest& request) {
+            return request.kind < kindCount && request.heading < HEADING_COUNT && laneOf(request.kind, request.heading) == lane;
+        };
+        if (!in.get(counts) || !in.getArray(tile.lanes.lanes[lane], counts[0]) || !in.getArray(waiting.items, counts[1]) ||
+            !std::all_of(tile.lanes.lanes[lane].begin(), tile.lanes.lanes[lane].end(), validMember) ||
+            !std::all_of(waiting.items.begin(), waiting.items.end(), validRequest)) {
+            return false;
+        }
+        in.align();
+    }
+    if (!in.getArray(tile.exitedByType, kindCount)) {
+        return false;
+    }
+    in.align();
+
+    tile.trafficLight.setState(static_cast<TrafficLightState>(header.lightState));
+    tile.phaseStart = header.phaseStart;
+    tile.handoffs = header.handoffs;
+    tile.lightChanges = header.lightChanges;
+    tile.conflicts = header.conflicts;
+    tile.outbox.clear();
+    tile.spatialHash.rebuild(agents);
+    return true;
+}
+
+
+// Journal de rejeu (--record) : tout ce qui fait évoluer les tuiles, pour revoir un passage d'une
+// longue simulation sans la relancer depuis le début.
+//   en-tête      ReplayHeader
+//   événements   ReplayEvent de 8 octets ; un événement ReplayTick (suivi du pas sur 8 octets)
+//                précède chaque changement de pas
+//   images clés  toutes les KEYFRAME_SECONDS : ReplayEvent ReplayKeyframe, pas, temps simulé, taille, puis nombre de
+//                tuiles, position de chaque tuile dans l'image clé et état de chaque tuile (writeTileState)
+//   index        pas et position de chaque image clé, puis ReplayFooter
+// Une tuile ne dépend que de son état, des changements de son feu et des usagers ajoutés à ses files
+// d'entrée. Pour aller à un instant, on charge donc l'image clé précédente puis on fait avancer la
+// seule tuile regardée en lui rendant ses événements : au plus KEYFRAME_SECONDS de simulation d'une tuile.
+const std::uint32_t REPLAY_MAGIC = 0x50524C54; // "TLRP"
+const std::uint32_t REPLAY_VERSION = 4;
+const float KEYFRAME_SECONDS = 10;
+
+struct ReplayHeader {
+    std::uint32_t magic, version;
+    std::uint64_t seed;
+    float dt;
+    std::int32_t columns, rows;
+    std::uint32_t kindCount;
+    std::uint64_t geometryHash;     // Voir geometryFingerprint
+    std::int64_t keyframeTicks;     // Pas entre deux images clés
+};
+
+enum ReplayEventType : std::uint8_t {
+    ReplayTick = 1,     // Pas des événements suivants
+    ReplayEnqueue,      // Usager ajouté à la file d'entrée de la tuile, admissible à partir de ce pas
+    ReplaySignal,       // Nouvel état du feu de la tuile, avant le déplacement de ce pas
+    ReplayKeyframe      // État de toutes les tuiles à la fin du pas
+};
+
+struct ReplayEvent {
+    std::uint8_t type;
+    std::uint8_t kind, heading;
+    std::uint8_t value;     // Virage de l'usager ou nouvel état du feu
+    std::uint32_t tile;
+};
+
+struct ReplayIndexEntry {
+    std::int64_t tick;
+    std::uint64_t offset;   // Position de l'événement ReplayKeyframe
+};
+
+struct ReplayFooter {
+    std::uint64_t indexOffset, keyframeCount;
+    std::int64_t lastTick;
+    std::uint32_t magic, padding;
+};
+
+// Écriture du journal pendant la simulation, depuis les parties en série du pas. Les événements
+// sont accumulés en mémoire et écrits par blocs.
+class ReplayRecorder {
+public:
+    ReplayRecorder() = default;
+    ReplayRecorder(const ReplayRecorder&) = delete;
+    ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+    ~ReplayRecorder() {
+        close();
+    }
+
+    bool open(const std::string& path, const ReplayHeader& header) {
+        out.open(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Erreur : Impossible d'écrire le journal de rejeu " << path << " !" << std::endl;
+            return false;
+        }
+        keyframeTicks = header.keyframeTicks;
+        buffer.put(header);
+        return true;
+    }
+
+    void enqueue(long long tick, std::uint32_t tile, const SpawnRequest& request) {
+        event(tick, { ReplayEnqueue, request.kind, request.heading, request.turnFlags, tile });
+    }
+
+    void signal(long long tick, std::uint32_t tile, TrafficLightState state) {
+        event(tick, { ReplaySignal, 0, 0, static_cast<std::uint8_t>(state), tile });
+    }
+
+    // Fin d'un pas : écrit une image clé quand elle est due
+    void stepDone(long long tick, double time, const std::vector<Intersection>& tiles) {
+        lastTick = tick;
+        if (tick % keyframeTicks == 0) {
+            keyframe(tick, time, tiles);
+        }
+    }
+
+    // time : horloge de la simulation, dont le rejeu repart pour dater les phases de feu comme elle
+    void keyframe(long long tick, double time, const std::vector<Intersection>& tiles) {
+        lastTick = tick;
+        index.push_back({ tick, written + buffer.bytes.size() });
+        buffer.put(ReplayEvent{ ReplayKeyframe, 0, 0, 0, 0 });
+        buffer.put(static_cast<std::int64_t>(tick));
+        buffer.put(time);
+        size_t sizeAt = buffer.bytes.size();
+        buffer.put(std::uint64_t(0));
+
+        size_t start = buffer.bytes.size();
+        buffer.put(static_cast<std::uint64_t>(tiles.size()));
+        size_t tableAt = buffer.bytes.size();
+        buffer.bytes.resize(tableAt + tiles.size() * sizeof(std::uint64_t));
+        for (size_t n = 0; n < tiles.size(); ++n) {
+            std::uint64_t tileOffset = buffer.bytes.size() - start;
+            std::memcpy(buffer.bytes.data() + tableAt + n * sizeof(std::uint64_t), &tileOffset, sizeof(tileOffset));
+            writeTileState(buffer, tiles[n]);
+        }
+        std::uint64_t size = buffer.bytes.size() - start;
+        std::memcpy(buffer.bytes.data() + sizeAt, &size, sizeof(size));
+
+        currentTick = -1; // Les événements suivants repartent d'un pas explicite
+        flush();
+    }
+
+    // Écrit l'index et le pied de page ; faux en cas d'erreur d'écriture
+    bool close() {
+        if (!out.is_open()) {
+            return true;
+        }
+        ReplayFooter footer = { written + buffer.bytes.size(), index.size(), lastTick, REPLAY_MAGIC, 0 };
+        buffer.putArray(index.data(), index.size());
+        buffer.put(footer);
+        flush();
+        out.close();
+        if (!out) {
+            std::cerr << "Erreur : écriture du journal de rejeu incomplète !" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::ofstream out;
+    ByteWriter buffer;
+    std::uint64_t written = 0;          // Octets déjà écrits dans le fichier
+    long long keyframeTicks = 1;
+    long long currentTick = -1;
+    long long lastTick = 0;
+    std::vector<ReplayIndexEntry> index;
+    static constexpr size_t FLUSH_BYTES = 1 << 20;
+
+    void event(long long tick, const ReplayEvent& replayEvent) {
+        if (tick != currentTick) {
+            buffer.put(ReplayEvent{ ReplayTick, 0, 0, 0, 0 });
+            buffer.put(static_cast<std::int64_t>(tick));
+            currentTick = tick;
+        }
+        buffer.put(replayEvent);
+        if (buffer.bytes.size() >= FLUSH_BYTES) {
+            flush();
+        }
+    }
+
+    void flush() {
+        out.write(reinterpret_cast<const char*>(buffer.bytes.data()), static_cast<std::streamsize>(buffer.bytes.size()));
+        written += buffer.bytes.size();
+        buffer.bytes.clear();
+    }
+};
+
+// Journal de rejeu projeté en mémoire. Un journal interrompu (sans index) est parcouru une fois
+// pour retrouver ses images clés.
+class ReplayLog {
+public:
+    ReplayHeader header = {};
+    std::vector<ReplayIndexEntry> keyframes;
+    long long lastTick = 0;         // Dernier pas enregistré
+    size_t eventsEnd = 0;           // Fin des événements (début de l'index)
+
+    bool open(const std::string& path, const GeometryTable& geometry) {
+        if (!file.open(path)) {
+            std::cerr << "Erreur : Impossible d'ouvrir le journal de rejeu " << path << " !" << std::endl;
+            return false;
+        }
+        ByteReader in{ file.data(), file.size() };
+        if (!in.get(header) || header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION || header.keyframeTicks <= 0 ||
+            header.columns <= 0 || header.rows <= 0) {
+            std::cerr << "Erreur : " << path << " n'est pas un journal de rejeu valide !" << std::endl;
+            return false;
+        }
+        if (header.kindCount != geometry.kinds.size() || header.geometryHash != geometryFingerprint(geometry)) {
+            std::cerr << "Erreur : le journal " << path << " a été enregistré avec une autre géométrie !" << std::endl;
+            return false;
+        }
+
+        ReplayFooter footer;
+        ByteReader tail{ file.data(), file.size(), file.size() - std::min(file.size(), sizeof(footer)) };
+        if (tail.get(footer) && footer.magic == REPLAY_MAGIC && footer.indexOffset <= file.size() &&
+            footer.keyframeCount == (file.size() - sizeof(footer) - footer.indexOffset) / sizeof(ReplayIndexEntry)) {
+            eventsEnd = footer.indexOffset;
+            lastTick = footer.lastTick;
+            ByteReader table{ file.data(), file.size() - sizeof(footer), eventsEnd };
+            table.getArray(keyframes, footer.keyframeCount);
+        }
+        else {
+            scan(in.offset);
+        }
+        if (keyframes.empty()) {
+            std::cerr << "Erreur : le journal " << path << " ne contient aucune image clé !" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const std::uint8_t* data() const { return file.data(); }
+
+    // Dernière image clé au plus tard au pas tick (la première si tick la précède)
+    const ReplayIndexEntry& keyframeBefore(long long tick) const {
+        auto it = std::upper_bound(keyframes.begin(), keyframes.end(), tick, [](long long t, const ReplayIndexEntry& entry) {
+            return t < entry.tick;
+        });
+        return it == keyframes.begin() ? keyframes.front() : *(it - 1);
+    }
+
+private:
+    MappedFile file;
+
+    // Reconstruit l'index en parcourant les événements jusqu'au dernier enregistrement complet
+    void scan(size_t offset) {
+        ByteReader in{ file.data(), file.size(), offset };
+        eventsEnd = offset;
+        ReplayEvent replayEvent;
+        while (in.get(replayEvent)) {
+            std::int64_t tick;
+            if (replayEvent.type == ReplayTick) {
+                if (!in.get(tick)) {
+                    break;
+                }
+                lastTick = tick;
+            }
+            else if (replayEvent.type == ReplayKeyframe) {
+                double time;
+                std::uint64_t size;
+                if (!in.get(tick) || !in.get(time) || !in.get(size) || size > file.size() - in.offset) {
+                    break;
+                }
+                keyframes.push_back({ tick, in.offset - sizeof(replayEvent) - sizeof(tick) - sizeof(time) - sizeof(size) });
+                lastTick = std::max<long long>(lastTick, tick);
+                in.offset += size;
+            }
+            else if (replayEvent.type != ReplayEnqueue && replayEvent.type != ReplaySignal) {
+                break;
+            }
+            eventsEnd = in.offset;
+        }
+    }
+};
+
+// Rejoue une tuile d'un journal : saut à n'importe quel pas, puis avance pas à pas
+class ReplayPlayer {
+public:
+    Intersection tile;
+    long long tick = 0;
+
+    ReplayPlayer(const ReplayLog& log, const GeometryTable& geometry, std::uint32_t tileIndex)
+        : tile(geometry, static_cast<int>(tileIndex % log.header.columns), static_cast<int>(tileIndex / log.header.columns)),
+          log(log), geometry(geometry), tileIndex(tileIndex) {}
+
+    double time() const { return clockTime; }
+
+    // Va au pas target, borné aux pas enregistrés ; faux si l'image clé est illisible
+    bool seek(long long target) {
+        target = std::clamp<long long>(target, log.keyframes.front().tick, log.lastTick);
+        const ReplayIndexEntry& keyframe = log.keyframeBefore(target);
+        ByteReader in{ log.data(), log.eventsEnd, keyframe.offset };
+        ReplayEvent replayEvent;
+        std::int64_t keyframeTick;
+        double keyframeTime;
+        std::uint64_t size, tileCount, tileOffset;
+        if (!in.get(replayEvent) || !in.get(keyframeTick) || !in.get(keyframeTime) || !in.get(size)) {
+            return false;
+        }
+        size_t start = in.offset;
+        if (size > log.eventsEnd - start || !in.get(tileCount) || tileIndex >= tileCount) {
+            return false;
+        }
+        in.offset += tileIndex * sizeof(std::uint64_t);
+        if (!in.get(tileOffset)) {
+            return false;
+        }
+        ByteReader state{ log.data(), start + size, start + tileOffset };
+        if (!readTileState(state, tile)) {
+            std::cerr << "Erreur : image clé illisible au pas " << keyframeTick << " !" << std::endl;
+            return false;
+        }
+
+        tick = keyframeTick;
+        clockTime = keyframeTime;
+        cursor = start + size;
+        while (tick < target && step()) {
+        }
+        return true;
+    }
+
+    // Avance d'un pas en rendant à la tuile ses événements ; faux à la fin du journal
+    bool step() {
+        if (tick >= log.lastTick) {
+            return false;
+        }
+        long long next = tick + 1;
+        double nextTime = clockTime + log.header.dt; // Même somme que SimClock::tick
+        ByteReader in{ log.data(), log.eventsEnd, cursor };
+        ReplayEvent replayEvent;
+        while (true) {
+            size_t at = in.offset;
+            std::int64_t eventTick;
+            double eventTime;
+            std::uint64_t size;
+            if (!in.get(replayEvent)) {
+                break;
+            }
+            if (replayEvent.type == ReplayTick) {
+                if (!in.get(eventTick) || eventTick > next) {
+                    in.offset = at;
+                    break;
+                }
+            }
+            else if (replayEvent.type == ReplayKeyframe) {
+                if (!in.get(eventTick) || !in.get(eventTime) || !in.get(size)) {
+                    break;
+                }
+                in.offset += size;
+            }
+            else if (replayEvent.tile != tileIndex) {
+                continue;
+            }
+            else if (replayEvent.type == ReplaySignal && replayEvent.value <= RedHorizontalOrangeVertical) {
+                // Comme Simulation::step : la phase qui se termine est close, puis le changement compté
+                tile.closePhase(tileIndex, nextTime, nullptr);
+                tile.trafficLight.setState(static_cast<TrafficLightState>(replayEvent.value));
+                ++tile.lightChanges;
+            }
+            else if (replayEvent.type == ReplayEnqueue && replayEvent.kind < geometry.kinds.size() && replayEvent.heading < HEADING_COUNT) {
+                tile.enqueue({ replayEvent.kind, replayEvent.heading, replayEvent.value });
+            }
+        }
+        cursor = in.offset;
+
+        tile.step(geometry, log.header.dt, next, log.header.columns, log.header.rows);
+        tile.outbox.clear();
+        tick = next;
+        clockTime = nextTime;
+        return true;
+    }
+
+private:
+    const ReplayLog& log;
+    const GeometryTable& geometry;
+    std::uint32_t tileIndex;
+    size_t cursor = 0;      // Premier événement pas encore rendu
+    double clockTime = 0;   // Temps simulé au pas tick, tel que l'horloge de la simulation l'avait
+};
+
+
+// Instantané de la simulation (--checkpoint / --restore) : tout l'état nécessaire pour reprendre
+// exactement au même pas, avec la même géométrie, la même demande et la même grille.
+//   en-tête      SnapshotHeader
+//   tableaux     arrivées par type, flux d'arrivées, échéanciers des feux et des arrivées
+//   tuiles       position de chaque tuile dans le fichier, puis état de chaque tuile (writeTileState)
+// Tout est aligné sur 8 octets et écrit tel qu'en mémoire : le fichier est projeté puis chaque tableau
+// est recopié d'un bloc, et les tuiles, indépendantes, sont restaurées en parallèle. Le générateur
+// aléatoire n'a pas d'état propre : la graine et le rang de chaque flux suffisent.
+const std::uint32_t SNAPSHOT_MAGIC = 0x4E534C54; // "TLSN"
+const std::uint32_t SNAPSHOT_VERSION = 3;
+
+struct SnapshotHeader {
+    std::uint32_t magic, version;
+    std::uint64_t seed;
+    double time;
+    std::int64_t ticks;
+    float dt;
+    std::int32_t columns, rows;
+    std::uint32_t kindCount;
+    std::uint64_t geometryHash;             // Voir geometryFingerprint
+    std::uint64_t streamCount, signalCount, arrivalCount;
+    std::uint64_t signalTick, arrivalTick;  // Tick courant de chaque échéancier
+};
+
+
+// Mesures des carrefours (--metrics) : une ligne CSV par approche et par phase de feu terminée.
+// Le pas ne fait que tenir des compteurs dans chaque tuile (Intersection::approaches) ; aux changements
+// de feu, la simulation dépose les lignes du pas dans une file et un thread d'écriture les met en forme
+// et les écrit, hors du pas.
+class MetricsWriter {
+public:
+    MetricsWriter() = default;
+    MetricsWriter(const MetricsWriter&) = delete;
+    MetricsWriter& operator=(const MetricsWriter&) = delete;
+
+    ~MetricsWriter() {
+        close();
+    }
+
+    bool open(const std::string& path, int gridColumns) {
+        out.open(path);
+        if (!out) {
+            std::cerr << "Erreur : Impossible d'écrire les mesures dans " << path << " !" << std::endl;
+            return false;
+        }
+        columns = static_cast<std::uint32_t>(gridColumns);
+        out << "tile,column,row,phase_start,phase_end,phase,approach,discharged,queue_max,queue_end,delay_mean,delay_max\n";
+        writer = std::thread([this] { writeLoop(); });
+        return true;
+    }
+
+    // Dépose les lignes d'un pas et vide records (thread de simulation)
+    void submit(std::vector<PhaseMetrics>& records) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.insert(pending.end(), records.begin(), records.end());
+        }
+        ready.notify_one();
+        records.clear();
+    }
+
+    // Écrit les lignes en attente puis ferme le fichier ; faux en cas d'erreur d'écriture
+    bool close() {
+        if (!writer.joinable()) {
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        writer.join();
+        out.close();
+        if (!out) {
+            std::cerr << "Erreur : écriture des mesures incomplète !" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::ofstream out;
+    std::uint32_t columns = 1;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<PhaseMetrics> pending;  // Lignes déposées, pas encore écrites
+    bool stopping = false;
+
+    void writeLoop() {
+        static const char* const phaseNames[] = { "red_horizontal", "orange_horizontal", "green_horizontal", "red_horizontal_orange_vertical" };
+        std::vector<PhaseMetrics> batch;
+        std::string line;
+        // Nombres écrits avec to_chars (6 chiffres significatifs comme le flux, sans ses coûts de locale)
+        auto field = [&line](auto value, char separator) {
+            char digits[32];
+            std::to_chars_result result;
+            if constexpr (std::is_floating_point_v<decltype(value)>) {
+                result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+            }
+            else {
+                result = std::to_chars(digits, digits + sizeof(digits), value);
+            }
+            line.append(digits, result.ptr);
+            line += separator;
+        };
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                batch.swap(pending);
+            }
+            line.clear();
+            for (const PhaseMetrics& record : batch) {
+                const ApproachCounters& counters = record.counters;
+                field(record.tile, ',');
+                field(record.tile % columns, ',');
+                field(record.tile / columns, ',');
+                field(record.start, ',');
+                field(record.end, ',');
+                line += phaseNames[record.state];
+                line += ',';
+                line += HEADING_NAMES[record.heading];
+                line += ',';
+                field(counters.discharged, ',');
+                field(counters.maxQueued, ',');
+                field(counters.queued, ',');
+                field(counters.discharged > 0 ? counters.delay / counters.discharged : 0.0, ',');
+                field(counters.maxDelay, '\n');
+            }
+            out.write(line.data(), static_cast<std::streamsize>(line.size()));
+            batch.clear();
+        }
+    }
+};
+
+
+// Simulation d'un réseau de columns x rows carrefours : avance les usagers et les feux sans rien
+// dessiner. La fenêtre ne fait que lire cet état pour l'afficher, ce qui permet de tourner sans fenêtre.
+// Chaque tuile a ses propres tableaux : la mémoire croît linéairement avec le nombre de carrefours.
+// Les tuiles avancent en parallèle sur le pool de threads ; tout ce qui traverse les tuiles
+// (apparitions, tirages aléatoires, transferts) est fait en série, dans l'ordre des tuiles, pour
+// que le résultat ne dépende pas du nombre de threads.
+class Simulation {
+public:
+    GeometryTable geometry;
+    int columns, rows;
+    std::vector<Intersection> intersections; // Rangées ligne par ligne
+
+    SimClock clock;
+    std::vector<int> spawnedByType;  // Usagers arrivés dans le réseau par type
+    std::uint64_t seed;              // Graine des tirages : une même graine rejoue la même simulation
+    SignalPlan signalPlan;           // Durées des phases, prises en compte au changement de phase suivant
+
+    Simulation(const GeometryTable& geometry, const DemandProfile& demand, float dt, std::uint64_t seed, int columns = 1, int rows = 1, unsigned threads = 1)
+        : geometry(geometry), columns(columns), rows(rows), clock(dt), spawnedByType(geometry.kinds.size()), seed(seed), demand(demand),
+          pool(std::make_unique<WorkStealingPool>(threads)), signalSchedule(SIM_DT), arrivalSchedule(SIM_DT) {
+        intersections.reserve(static_cast<size_t>(columns) * rows);
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < columns; ++c) {
+                intersections.emplace_back(geometry, c, r);
+                signalSchedule.schedule(signalSchedule.ticksFor(signalPlan.phaseDuration(intersections.back().trafficLight.getState())),
+                                        static_cast<std::uint32_t>(intersections.size() - 1));
+            }
+        }
+
+        // Un flux d'arrivées par type et par approche d'entrée du réseau. Les arrivées sont tirées au
+        // débit maximal du profil puis gardées avec la probabilité multiplicateur / maximum (amincissement),
+        // ce qui donne exactement un processus de Poisson de débit variable.
+        double peak = demand.maxMultiplier();
+        for (const Intersection& intersection : intersections) {
+            for (std::uint8_t heading = 0; heading < HEADING_COUNT; ++heading) {
+                if (!isNetworkEntry(intersection, heading)) {
+                    continue;
+                }
+                for (std::uint8_t kind = 0; kind < geometry.kinds.size(); ++kind) {
+                    double rate = demand.ratePerHour[kind][heading] / 3600.0 * peak;
+                    if (rate <= 0) {
+                        continue;
+                    }
+                    ArrivalStream stream = { static_cast<std::uint32_t>(&intersection - intersections.data()), kind, heading, rate, 0, 0 };
+                    RandomBlock bits = arrivalBits(stream);
+                    stream.nextArrival = generateInterArrival(rate, uniformFromBits(bits[0], bits[1]));
+                    arrivalSchedule.schedule(arrivalSchedule.tickAt(stream.nextArrival), static_cast<std::uint32_t>(arrivalStreams.size()));
+                    arrivalStreams.push_back(stream);
+                }
+            }
+        }
+    }
+
+    // Avance la simulation d'un pas de l'horloge
+    void step() {
+        clock.tick();
+
+        // Changements de feux échus ; chaque feu reprogramme sa phase suivante
+        signalSchedule.advance(clock.time, [&](const TimingWheel::TimerEvent& event) {
+            Intersection& intersection = intersections[event.target];
+            intersection.closePhase(event.target, clock.time, metrics ? &phaseRecords : nullptr);
+            intersection.trafficLight.changeState();
+            ++intersection.lightChanges;
+            if (recorder) {
+                recorder->signal(clock.ticks, event.target, intersection.trafficLight.getState());
+            }
+            signalSchedule.schedule(event.due + signalSchedule.ticksFor(signalPlan.phaseDuration(intersection.trafficLight.getState())), event.target);
+        });
+
+        // Arrivées échues, insérées en lot dans la file d'entrée de leur tuile : elles entrent sur leur
+        // voie pendant le pas dès qu'il y a de la place, sinon elles attendent (aucune n'est perdue)
+        double peak = demand.maxMultiplier();
+        arrivalSchedule.advance(clock.time, [&](const TimingWheel::TimerEvent& event) {
+            ArrivalStream& stream = arrivalStreams[event.target];
+            while (stream.nextArrival <= clock.time + TIME_EPSILON) {
+                RandomBlock bits = arrivalBits(stream);
+                if (generateAcceptance(demand.multiplier(stream.nextArrival) / peak, bits[2])) {
+                    SpawnRequest request = { stream.kind, stream.heading, generateRandomTurn(bits[3]) };
+                    intersections[stream.intersection].enqueue(request);
+                    ++spawnedByType[stream.kind];
+                    if (recorder) {
+                        recorder->enqueue(clock.ticks, stream.intersection, request);
+                    }
+                }
+                ++stream.draws;
+                bits = arrivalBits(stream);
+                stream.nextArrival += generateInterArrival(stream.rate, uniformFromBits(bits[0], bits[1]));
+            }
+            arrivalSchedule.schedule(arrivalSchedule.tickAt(stream.nextArrival), event.target);
+        });
+
+        pool->parallelFor(intersections.size(), INTERSECTIONS_PER_TASK, [&](size_t begin, size_t end) {
+            for (size_t n = begin; n < end; ++n) {
+                intersections[n].step(geometry, clock.dt, clock.ticks, columns, rows);
+            }
+        });
+
+        // Transferts dans l'ordre des tuiles : le résultat ne dépend pas de l'ordre de traitement.
+        // Le virage au carrefour suivant est tiré ici, d'après la tuile de départ, le pas et le rang du transfert.
+        for (Intersection& intersection : intersections) {
+            std::uint32_t source = static_cast<std::uint32_t>(&intersection - intersections.data());
+            for (size_t k = 0; k < intersection.outbox.size(); ++k) {
+                Transfer& transfer = intersection.outbox[k];
+                RandomBlock bits = philox(seed, { RandomHandoff | static_cast<std::uint32_t>(k) << 8, source,
+                                                  static_cast<std::uint32_t>(clock.ticks), static_cast<std::uint32_t>(static_cast<std::uint64_t>(clock.ticks) >> 32) });
+                transfer.request.turnFlags = generateRandomTurn(bits[0]);
+                intersections[transfer.target].enqueue(transfer.request);
+                if (recorder) {
+                    recorder->enqueue(clock.ticks + 1, transfer.target, transfer.request);
+                }
+            }
+            intersection.outbox.clear();
+        }
+
+        if (recorder) {
+            recorder->stepDone(clock.ticks, clock.time, intersections);
+        }
+        if (metrics && !phaseRecords.empty()) {
+            metrics->submit(phaseRecords);
+        }
+    }
+
+    // Écrit les mesures de chaque phase de feu terminée à partir de maintenant (voir MetricsWriter)
+    bool startMetrics(const std::string& path) {
+        metrics = std::make_unique<MetricsWriter>();
+        if (!metrics->open(path, columns)) {
+            metrics.reset();
+            return false;
+        }
+        return true;
+    }
+
+    bool stopMetrics() {
+        bool written = !metrics || metrics->close();
+        metrics.reset();
+        return written;
+    }
+
+    // Enregistre la suite de la simulation dans un journal de rejeu, à partir d'une image clé de l'état courant
+    bool startRecording(const std::string& path) {
+        recorder = std::make_unique<ReplayRecorder>();
+        long long keyframeTicks = std::max(static_cast<long long>(std::lround(KEYFRAME_SECONDS / clock.dt)), 1LL);
+        ReplayHeader header = { REPLAY_MAGIC, REPLAY_VERSION, seed, clock.dt, columns, rows,
+                                static_cast<std::uint32_t>(geometry.kinds.size()), geometryFingerprint(geometry), keyframeTicks };
+        if (!recorder->open(path, header)) {
+            recorder.reset();
+            return false;
+        }
+        recorder->keyframe(clock.ticks, clock.time, intersections);
+        return true;
+    }
+
+    // Termine le journal de rejeu (index des images clés) ; faux en cas d'erreur d'écriture
+    bool stopRecording() {
+        bool written = !recorder || recorder->close();
+        recorder.reset();
+        return written;
+    }
+
+    size_t threadCount() const { return pool->threadCount(); }
+
+    // Dans un processus créé par fork, seul le thread appelant existe : le pool, le journal et les mesures
+    // hérités sont abandonnés sans être détruits (leurs threads et leurs fichiers appartiennent au parent)
+    void detachAfterFork(unsigned threads) {
+        (void)pool.release();
+        (void)recorder.release();
+        (void)metrics.release();
+        pool = std::make_unique<WorkStealingPool>(threads);
+    }
+
+    // Écrit l'état complet de la simulation dans un instantané (voir SnapshotHeader)
+    bool saveSnapshot(const std::string& path) const {
+        std::vector<TimingWheel::TimerEvent> signals = signalSchedule.pending();
+        std::vector<TimingWheel::TimerEvent> arrivals = arrivalSchedule.pending();
+        SnapshotHeader header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, seed, clock.time, clock.ticks, clock.dt, columns, rows,
+                                  static_cast<std::uint32_t>(geometry.kinds.size()), geometryFingerprint(geometry),
+                                  arrivalStreams.size(), signals.size(), arrivals.size(),
+                                  signalSchedule.now(), arrivalSchedule.now() };
+        ByteWriter out;
+        out.put(header);
+        out.putArray(spawnedByType.data(), spawnedByType.size());
+        out.align();
+        out.putArray(arrivalStreams.data(), arrivalStreams.size());
+        out.putArray(signals.data(), signals.size());
+        out.putArray(arrivals.data(), arrivals.size());
+
+        size_t tableAt = out.bytes.size();
+        out.bytes.resize(tableAt + intersections.size() * sizeof(std::uint64_t));
+        for (size_t n = 0; n < intersections.size(); ++n) {
+            std::uint64_t tileOffset = out.bytes.size();
+            std::memcpy(out.bytes.data() + tableAt + n * sizeof(std::uint64_t), &tileOffset, sizeof(tileOffset));
+            writeTileState(out, intersections[n]);
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(out.bytes.data()), static_cast<std::streamsize>(out.bytes.size()));
+        if (!file) {
+            std::cerr << "Erreur : Impossible d'écrire l'instantané " << path << " !" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Reprend l'état d'un instantané écrit avec la même géométrie, la même demande et la même grille.
+    // En cas d'échec, la simulation est à recréer.
+    bool restoreSnapshot(const std::string& path) {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "Erreur : Impossible d'ouvrir l'instantané " << path << " !" << std::endl;
+            return false;
+        }
+        ByteReader in{ file.data(), file.size() };
+        SnapshotHeader header;
+        if (!in.get(header) || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+            std::cerr << "Erreur : " << path << " n'est pas un instantané valide !" << std::endl;
+            return false;
+        }
+        if (header.columns != columns || header.rows != rows || header.kindCount != geometry.kinds.size() ||
+            header.geometryHash != geometryFingerprint(geometry) || header.dt != clock.dt || header.streamCount != arrivalStreams.size()) {
+            std::cerr << "Erreur : l'instantané " << path << " a été pris avec une autre grille, géométrie, demande ou un autre pas de temps !" << std::endl;
+            return false;
+        }
+
+        std::vector<int> spawned;
+        std::vector<ArrivalStream> streams;
+        std::vector<TimingWheel::TimerEvent> signals, arrivals;
+        bool valid = in.getArray(spawned, header.kindCount);
+        in.align();
+        valid = valid && in.getArray(streams, header.streamCount) && in.getArray(signals, header.signalCount) && in.getArray(arrivals, header.arrivalCount);
+        for (size_t k = 0; valid && k < streams.size(); ++k) {
+            const ArrivalStream& stream = arrivalStreams[k];
+            valid = streams[k].intersection == stream.intersection && streams[k].kind == stream.kind && streams[k].heading == stream.heading;
+        }
+        auto validTarget = [](size_t count) {
+            return [count](const TimingWheel::TimerEvent& event) { return event.target < count; };
+        };
+        valid = valid && std::all_of(signals.begin(), signals.end(), validTarget(intersections.size())) &&
+                std::all_of(arrivals.begin(), arrivals.end(), validTarget(streams.size()));
+        size_t tableAt = in.offset;
+        if (!valid || intersections.size() > (file.size() - std::min(tableAt, file.size())) / sizeof(std::uint64_t)) {
+            std::cerr << "Erreur : l'instantané " << path << " est incomplet ou ne correspond pas à cette demande !" << std::endl;
+            return false;
+        }
+
+        // Les tuiles sont indépendantes : chacune est restaurée par le pool depuis sa position
+        std::atomic<bool> tilesValid{ true };
+        pool->parallelFor(intersections.size(), INTERSECTIONS_PER_TASK, [&](size_t begin, size_t end) {
+            for (size_t n = begin; n < end; ++n) {
+                std::uint64_t tileOffset;
+                std::memcpy(&tileOffset, file.data() + tableAt + n * sizeof(std::uint64_t), sizeof(tileOffset));
+                ByteReader tile{ file.data(), file.size(), static_cast<size_t>(tileOffset) };
+                if (!readTileState(tile, intersections[n])) {
+                    tilesValid.store(false, std::memory_order_relaxed);
+                }
+            }
+        });
+        if (!tilesValid.load()) {
+            std::cerr << "Erreur : état de tuile invalide dans l'instantané " << path << " !" << std::endl;
+            return false;
+        }
+
+        seed = header.seed;
+        clock.time = header.time;
+        clock.ticks = header.ticks;
+        spawnedByType = std::move(spawned);
+        arrivalStreams = std::move(streams);
+        signalSchedule.restore(header.signalTick, signals);
+        arrivalSchedule.restore(header.arrivalTick, arrivals);
+        return true;
+    }
+
+    // Empreinte exacte de la position et de la vitesse de chaque usager, tuile par tuile : deux
+    // exécutions qui donnent la même valeur ont fait les mêmes calculs au bit près
+    std::uint64_t positionChecksum() const {
+        Fingerprint checksum;
+        for (const Intersection& intersection : intersections) {
+            const AgentStore& agents = intersection.agents;
+            checksum.add(static_cast<std::uint64_t>(agents.size()));
+            for (size_t i = 0; i < agents.size(); ++i) {
+                checksum.add(agents.posX[i]);
+                checksum.add(agents.posY[i]);
+                checksum.add(agents.speed[i]);
+            }
+        }
+        return checksum.value;
+    }
+
+    // Écrit le bilan de la simulation (une valeur par ligne, format clé=valeur)
+    void writeSummary(std::ostream& out, double wallSeconds) const {
+        std::vector<size_t> onMap(geometry.kinds.size());
+        std::vector<int> exitedByType(geometry.kinds.size());
+        size_t agentCapacity = 0;
+        int lightChanges = 0, handoffs = 0, conflicts = 0;
+        size_t waiting = 0;
+        for (const Intersection& intersection : intersections) {
+            waiting += intersection.waitingCount();
+            for (size_t i = 0; i < intersection.agents.size(); ++i) {
+                ++onMap[intersection.agents.kind[i]];
+            }
+            for (const EntryQueue& queue : intersection.inbox) {
+                for (size_t k = queue.head; k < queue.items.size(); ++k) {
+                    ++onMap[queue.items[k].kind];
+                }
+            }
+            for (size_t k = 0; k < geometry.kinds.size(); ++k) {
+                exitedByType[k] += intersection.exitedByType[k];
+            }
+            agentCapacity += intersection.agents.capacity();
+            lightChanges += intersection.lightChanges;
+            handoffs += intersection.handoffs;
+            conflicts += intersection.conflicts;
+        }
+
+        out << "sim_seconds=" << clock.time << "\n";
+        out << "ticks=" << clock.ticks << "\n";
+        out << "wall_seconds=" << wallSeconds << "\n";
+        out << "speedup=" << (wallSeconds > 0 ? clock.time / wallSeconds : 0) << "\n";
+        out << "intersections=" << intersections.size() << "\n";
+        out << "threads=" << pool->threadCount() << "\n";
+        out << "seed=" << seed << "\n";
+        out << "light_changes=" << lightChanges << "\n";
+        out << "agent_capacity=" << agentCapacity << "\n";
+        out << "waiting_at_entry=" << waiting << "\n";
+        out << "handoffs=" << handoffs << "\n";
+        out << "conflicts=" << conflicts << "\n";
+        out << "position_checksum=" << positionChecksum() << "\n";
+        for (size_t i = 0; i < geometry.kinds.size(); ++i) {
+            const std::string& name = geometry.kinds[i].name;
+            out << name << "_spawned=" << spawnedByType[i] << "\n";
+            out << name << "_on_map=" << onMap[i] << "\n";
+            out << name << "_exited=" << exitedByType[i] << "\n";
+        }
+    }
+
+private:
+    // Arrivées d'un type d'usager sur une approche d'entrée
+    struct ArrivalStream {
+        std::uint32_t intersection;
+        std::uint8_t kind;
+        std::uint8_t heading;
+        double rate;            // Débit de tirage (par seconde, au maximum du profil)
+        double nextArrival;     // Instant de la prochaine arrivée candidate
+        std::uint64_t draws;    // Rang de cette arrivée candidate dans le flux
+    };
+
+    // Tirages de l'arrivée candidate courante d'un flux : mots 0 et 1 pour le délai qui la précède,
+    // mot 2 pour l'amincissement, mot 3 pour le virage
+    RandomBlock arrivalBits(const ArrivalStream& stream) const {
+        return philox(seed, { RandomArrival | static_cast<std::uint32_t>(stream.kind) << 8 | static_cast<std::uint32_t>(stream.heading) << 16,
+                              stream.intersection, static_cast<std::uint32_t>(stream.draws), static_cast<std::uint32_t>(stream.draws >> 32) });
+    }
+
+    DemandProfile demand;
+    std::unique_ptr<WorkStealingPool> pool;
+    TimingWheel signalSchedule;
+    TimingWheel arrivalSchedule;            // Prochaine arrivée de chaque flux
+    std::vector<ArrivalStream> arrivalStreams;
+    std::unique_ptr<ReplayRecorder> recorder; // Journal de rejeu en cours d'écriture (--record)
+    std::unique_ptr<MetricsWriter> metrics;   // Mesures en cours d'écriture (--metrics)
+    std::vector<PhaseMetrics> phaseRecords;   // Mesures des phases terminées pendant le pas
+    static constexpr double TIME_EPSILON = 1e-6;
+    static constexpr size_t INTERSECTIONS_PER_TASK = 64; // Tuiles par paquet du pool
+
+    // Un usager avec ce cap arrive-t-il de l'extérieur du réseau dans cette tuile ?
+    bool isNetworkEntry(const Intersection& intersection, std::uint8_t heading) const {
+        switch (heading) {
+        case HeadingEast:
+            return intersection.column == 0;
+        case HeadingWest:
+            return intersection.column == columns - 1;
+        case HeadingSouth:
+            return intersection.row == 0;
+        default:
+            return intersection.row == rows - 1;
+        }
+    }
+};
+
+
+// Branche d'une comparaison de plans de feux : plan appliqué à partir de l'état commun et bilan obtenu
+struct BranchResult {
+    SignalPlan plan;
+    bool completed = false;
+    std::string summary;    // Bilan de la branche (voir Simulation::writeSummary)
+};
+
+// Fait avancer la simulation de seconds secondes avec le plan donné et retourne son bilan
+std::string runBranch(Simulation& simulation, const SignalPlan& plan, double seconds) {
+    simulation.signalPlan = plan;
+    auto start = std::chrono::steady_clock::now();
+    long long totalTicks = static_cast<long long>(seconds / simulation.clock.dt + 0.5);
+    for (long long i = 0; i < totalTicks; ++i) {
+        simulation.step();
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::ostringstream summary;
+    simulation.writeSummary(summary, wallSeconds);
+    return summary.str();
+}
+
+// Fait repartir la simulation de son état courant avec chacun des plans, pendant seconds secondes
+// simulées. Toutes les branches voient les mêmes arrivées (même graine, mêmes compteurs), seul le
+// plan de feux change. Sous POSIX, chaque branche est un processus créé par fork : il partage la
+// mémoire du parent en copie sur écriture et ne paie que les pages qu'il modifie, avance avec sa
+// part des threads puis renvoie son bilan par un tube. Windows n'a pas de fork : les branches y
+// sont jouées l'une après l'autre depuis un instantané de l'état commun, puis cet état est rétabli.
+// À appeler sans journal de rejeu en cours ; la simulation du parent n'est pas modifiée.
+std::vector<BranchResult> runBranches(Simulation& simulation, const std::vector<SignalPlan>& plans, double seconds) {
+    std::vector<BranchResult> results(plans.size());
+    for (size_t k = 0; k < plans.size(); ++k) {
+        results[k].plan = plans[k];
+    }
+
+#ifdef _WIN32
+    std::string snapshotPath = (std::filesystem::temp_directory_path() / "traffic_light_branches.tls").string();
+    SignalPlan commonPlan = simulation.signalPlan;
+    if (!simulation.saveSnapshot(snapshotPath)) {
+        return results;
+    }
+    for (BranchResult& result : results) {
+        if (!simulation.restoreSnapshot(snapshotPath)) {
+            break;
+        }
+        result.summary = runBranch(simulation, result.plan, seconds);
+        result.completed = true;
+    }
+    simulation.restoreSnapshot(snapshotPath);
+    simulation.signalPlan = commonPlan;
+    std::filesystem::remove(snapshotPath);
+#else
+    unsigned threadsPerBranch = std::max(static_cast<unsigned>(simulation.threadCount() / std::max<size_t>(plans.size(), 1)), 1u);
+    std::vector<pid_t> children(plans.size(), -1);
+    std::vector<int> pipes(plans.size(), -1);
+    for (size_t k = 0; k < plans.size(); ++k) {
+        int ends[2];
+        if (pipe(ends) != 0) {
+            std::cerr << "Erreur : Impossible de créer le tube de la branche " << k << " !" << std::endl;
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Enfant : rien n'est détruit à la sortie, tout appartient aussi au parent
+            close(ends[0]);
+            simulation.detachAfterFork(threadsPerBranch);
+            std::string summary = runBranch(simulation, plans[k], seconds);
+            size_t sent = 0;
+            while (sent < summary.size()) {
+                ssize_t count = write(ends[1], summary.data() + sent, summary.size() - sent);
+                if (count <= 0) {
+                    _exit(1);
+                }
+                sent += static_cast<size_t>(count);
+            }
+            _exit(0);
+        }
+        close(ends[1]);
+        if (pid < 0) {
+            std::cerr << "Erreur : Impossible de créer le processus de la branche " << k << " !" << std::endl;
+            close(ends[0]);
+            continue;
+        }
+        children[k] = pid;
+        pipes[k] = ends[0];
+    }
+
+    // Les bilans sont petits : lire les tubes l'un après l'autre ne bloque aucune branche
+    for (size_t k = 0; k < plans.size(); ++k) {
+        if (children[k] < 0) {
+            continue;
+        }
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(pipes[k], buffer, sizeof(buffer))) > 0) {
+            results[k].summary.append(buffer, static_cast<size_t>(count));
+        }
+        close(pipes[k]);
+        int status = 0;
+        waitpid(children[k], &status, 0);
+        results[k].completed = WIFEXITED(status) && WEXITSTATUS(status) == 0 && !results[k].summary.empty();
+    }
+#endif
+    return results;
+}
+
+
+// Options de la ligne de commande
+struct Options {
+    bool headless = false;
+    float headlessSeconds = 0;   // Durée simulée en mode headless
+    std::string outputPath;      // Fichier du bilan (sortie standard si vide)
+    float dt = SIM_DT;           // Pas de temps fixe de la simulation
+    std::string geometryPath;    // Table de géométrie (géométrie par défaut si vide)
+    std::string demandPath;      // Débits d'arrivée (demande par défaut si vide)
+    int gridColumns = 1;         // Taille du réseau de carrefours
+    int gridRows = 1;
+    unsigned threads = std::max(std::thread::hardware_concurrency(), 1u); // Threads du pas de simulation
+    std::uint64_t seed = randomSeed(); // Graine des tirages (au hasard si --seed n'est pas donné)
+    std::string assetsPath = ASSET_PACK; // Paquet d'images chargé par la fenêtre
+    std::string buildAssetsPath;         // Si non vide : construit ce paquet depuis IMAGE_DIR puis quitte
+    std::string recordPath;      // Journal de rejeu à écrire (aucun si vide)
+    std::string metricsPath;     // Mesures des carrefours à écrire en CSV (aucune si vide)
+    std::string restorePath;     // Instantané d'où repartir (aucun si vide)
+    std::string checkpointPath;  // Instantané écrit à la fin du mode headless (aucun si vide)
+    std::vector<SignalPlan> branchPlans; // Plans de feux comparés à partir de la fin du mode headless
+    float branchSeconds = 0;     // Durée simulée de chaque branche (durée du mode headless si nulle)
+    std::string replayPath;      // Journal à rejouer au lieu de simuler (aucun si vide)
+    int shownColumn = 0;         // Carrefour affiché (ou rejoué)
+    int shownRow = 0;
+};
+
+// Lit un nombre qui occupe tout le texte (pas d'exception : faux si le texte n'est pas un nombre
+// de ce type, fini pour un flottant). Un entier non signé refuse le signe moins.
+template <typename T>
+bool parseNumber(const char* text, T& value) {
+    const char* end = text + std::strlen(text);
+    T parsed;
+    auto [ptr, error] = std::from_chars(text, end, parsed);
+    if (error != std::errc() || ptr != end) {
+        return false;
+    }
+    if constexpr (std::is_floating_point_v<T>) {
+        if (!std::isfinite(parsed)) {
+            return false;
+        }
+    }
+    value = parsed;
+    return true;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    auto usage = [&]() {
+        std::cerr << "Usage : " << argv[0] << " [--headless <secondes> [--output <fichier>]] [--dt <secondes>] [--seed <graine>] [--geometry <fichier>] [--demand <fichier>] [--grid <colonnes> <lignes>] [--threads <nombre>] [--assets <paquet>] [--build-assets <paquet>] [--restore <instantané>] [--checkpoint <instantané>] [--branch <plan> [--branch-seconds <secondes>]] [--metrics <fichier csv>] [--record <journal>] [--replay <journal>] [--show <colonne> <ligne>]" << std::endl;
+        return false;
+    };
+    // Valeur numérique text de l'option arg ; message d'erreur et usage si ce n'en est pas une
+    auto number = [&](const std::string& arg, const char* text, auto& value) {
+        if (!parseNumber(text, value)) {
+            std::cerr << "Erreur : valeur invalide pour " << arg << " : " << text << " !" << std::endl;
+            return usage();
+        }
+        return true;
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless" && i + 1 < argc) {
+            options.headless = true;
+            if (!number(arg, argv[++i], options.headlessSeconds)) {
+                return false;
+            }
+            if (options.headlessSeconds < 0) {
+                std::cerr << "Erreur : la durée simulée ne peut pas être négative !" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            options.outputPath = argv[++i];
+        }
+        else if (arg == "--geometry" && i + 1 < argc) {
+            options.geometryPath = argv[++i];
+        }
+        else if (arg == "--demand" && i + 1 < argc) {
+            options.demandPath = argv[++i];
+        }
+        else if (arg == "--grid" && i + 2 < argc) {
+            if (!number(arg, argv[++i], options.gridColumns) || !number(arg, argv[++i], options.gridRows)) {
+                return false;
+            }
+            if (options.gridColumns <= 0 || options.gridRows <= 0) {
+                std::cerr << "Erreur : le réseau doit compter au moins un carrefour !" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--assets" && i + 1 < argc) {
+            options.assetsPath = argv[++i];
+        }
+        else if (arg == "--build-assets" && i + 1 < argc) {
+            options.buildAssetsPath = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            int threads;
+            if (!number(arg, argv[++i], threads)) {
+                return false;
+            }
+            if (threads <= 0) {
+                std::cerr << "Erreur : il faut au moins un thread !" << std::endl;
+                return false;
+            }
+            options.threads = static_cast<unsigned>(threads);
+        }
+        else if (arg == "--restore" && i + 1 < argc) {
+            options.restorePath = argv[++i];
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            options.checkpointPath = argv[++i];
+        }
+        else if (arg == "--branch" && i + 1 < argc) {
+            SignalPlan plan;
+            if (!parseSignalPlan(argv[++i], plan)) {
+                std::cerr << "Erreur : plan de feux attendu sous la forme rouge,vert,orange,rouge-orange (secondes) !" << std::endl;
+                return false;
+            }
+            options.branchPlans.push_back(plan);
+        }
+        else if (arg == "--branch-seconds" && i + 1 < argc) {
+            if (!number(arg, argv[++i], options.branchSeconds)) {
+                return false;
+            }
+            if (options.branchSeconds < 0) {
+                std::cerr << "Erreur : la durée des branches ne peut pas être négative !" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--metrics" && i + 1 < argc) {
+            options.metricsPath = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        }
+        else if (arg == "--show" && i + 2 < argc) {
+            if (!number(arg, argv[++i], options.shownColumn) || !number(arg, argv[++i], options.shownRow)) {
+                return false;
+            }
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            // Entier non signé : une graine négative est refusée au lieu de boucler sur 2^64
+            if (!number(arg, argv[++i], options.seed)) {
+                return false;
+            }
+        }
+        else if (arg == "--dt" && i + 1 < argc) {
+            if (!number(arg, argv[++i], options.dt)) {
+                return false;
+            }
+            if (options.dt <= 0) {
+                std::cerr << "Erreur : le pas de temps doit être positif !" << std::endl;
+                return false;
+            }
+        }
+        else {
+            return usage();
+        }
+    }
+    if (options.replayPath.empty() && (options.shownColumn < 0 || options.shownColumn >= options.gridColumns || options.shownRow < 0 || options.shownRow >= options.gridRows)) {
+        std::cerr << "Erreur : le carrefour affiché doit être dans le réseau !" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Mode sans fenêtre : avance la simulation aussi vite que possible puis écrit le bilan, suivi du
+// bilan de chaque branche (--branch) partie de l'état final
+int runHeadless(const Options& options, const GeometryTable& geometry, const DemandProfile& demand) {
+    Simulation simulation(geometry, demand, options.dt, options.seed, options.gridColumns, options.gridRows, options.threads);
+    if (!options.restorePath.empty() && !simulation.restoreSnapshot(options.restorePath)) {
+        return -1;
+    }
+    if (!options.recordPath.empty() && !simulation.startRecording(options.recordPath)) {
+        return -1;
+    }
+    if (!options.metricsPath.empty() && !simulation.startMetrics(options.metricsPath)) {
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long long totalTicks = static_cast<long long>(options.headlessSeconds / options.dt + 0.5f);
+    for (long long i = 0; i < totalTicks; ++i) {
+        simulation.step();
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!simulation.stopRecording() || !simulation.stopMetrics() || (!options.checkpointPath.empty() && !simulation.saveSnapshot(options.checkpointPath))) {
+        return -1;
+    }
+
+    std::vector<BranchResult> branches;
+    if (!options.branchPlans.empty()) {
+        branches = runBranches(simulation, options.branchPlans, options.branchSeconds > 0 ? options.branchSeconds : options.headlessSeconds);
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << "Erreur : Impossible d'écrire le bilan dans " << options.outputPath << " !" << std::endl;
+            return -1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+    simulation.writeSummary(out, wallSeconds);
+    bool completed = true;
+    for (size_t k = 0; k < branches.size(); ++k) {
+        out << "branch=" << k << "\n";
+        out << "plan=" << formatSignalPlan(branches[k].plan) << "\n";
+        out << branches[k].summary;
+        if (!branches[k].completed) {
+            std::cerr << "Erreur : la branche " << k << " n'a pas abouti !" << std::endl;
+            completed = false;
+        }
+    }
+    return completed ? 0 : -1;
+}
+
+// Rejeu sans fenêtre : va à l'instant demandé du journal et écrit l'état du carrefour rejoué
+int runReplayHeadless(const Options& options, const GeometryTable& geometry, const ReplayLog& log) {
+    ReplayPlayer player(log, geometry, static_cast<std::uint32_t>(options.shownRow * log.header.columns + options.shownColumn));
+    auto start = std::chrono::steady_clock::now();
+    if (!player.seek(std::llround(options.headlessSeconds / log.header.dt))) {
+        return -1;
+    }
+    double seekSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << "Erreur : Impossible d'écrire le bilan dans " << options.outputPath << " !" << std::endl;
+            return -1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+    const Intersection& tile = player.tile;
+    out << "replay_tick=" << player.tick << "\n";
+    out << "sim_seconds=" << player.time() << "\n";
+    out << "keyframe_tick=" << log.keyframeBefore(player.tick).tick << "\n";
+    out << "seek_milliseconds=" << seekSeconds * 1000 << "\n";
+    out << "light_state=" << tile.trafficLight.getState() << "\n";
+    out << "light_changes=" << tile.lightChanges << "\n";
+    out << "agents=" << tile.agents.size() << "\n";
+    out << "waiting_at_entry=" << tile.waitingCount() << "\n";
+    out << "conflicts=" << tile.conflicts << "\n";
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return -1;
+    }
+
+    GeometryTable geometry = defaultGeometry();
+    if (!options.geometryPath.empty() && !loadGeometry(options.geometryPath, geometry)) {
+        return -1;
+    }
+    DemandProfile demand = defaultDemand(geometry);
+    if (!options.demandPath.empty() && !loadDemand(options.demandPath, geometry, demand)) {
+        return -1;
+    }
+
+    ReplayLog replayLog;
+    if (!options.replayPath.empty()) {
+        if (!replayLog.open(options.replayPath, geometry)) {
+            return -1;
+        }
+        if (options.shownColumn < 0 || options.shownColumn >= replayLog.header.columns || options.shownRow < 0 || options.shownRow >= replayLog.header.rows) {
+            std::cerr << "Erreur : le journal compte " << replayLog.header.columns << " x " << replayLog.header.rows << " carrefours !" << std::endl;
+            return -1;
+        }
+        if (options.headless) {
+            return runReplayHeadless(options, geometry, replayLog);
+        }
+    }
+
+    if (options.headless) {
+        return runHeadless(options, geometry, demand);
+    }
+
+    if (!options.buildAssetsPath.empty()) {
+        AssetData data;
+        return prepareAssets(geometry, IMAGE_DIR, data) && writeAssetPack(options.buildAssetsPath, data) ? 0 : -1;
+    }
+
+    sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Traffic Simulation with Background");
+    window.setFramerateLimit(60);
+
+    // Paquet d'images projeté en mémoire ; sans paquet, les images sources sont décodées en
+    // arrière-plan et apparaissent au fur et à mesure
+    Assets assets;
+    std::optional<AssetLoader> assetLoader;
+    if (!loadAssetPack(options.assetsPath, geometry, assets)) {
+        std::cerr << "Paquet d'images " << options.assetsPath << " absent, chargement depuis " << IMAGE_DIR << " (voir --build-assets)" << std::endl;
+        assetLoader.emplace(geometry, IMAGE_DIR);
+    }
+    sf::Sprite backgroundSprite;
+    bool loadFailed = false;
+
+    // La fenêtre affiche un carrefour du réseau : celui de la simulation, ou celui du journal rejoué
+    std::optional<Simulation> simulation;
+    std::optional<ReplayPlayer> replay;
+    Intersection* shown = nullptr;
+    if (options.replayPath.empty()) {
+        simulation.emplace(geometry, demand, options.dt, options.seed, options.gridColumns, options.gridRows, options.threads);
+        if (!options.restorePath.empty() && !simulation->restoreSnapshot(options.restorePath)) {
+            return -1;
+        }
+        std::cout << "Graine : " << simulation->seed << " (--seed pour rejouer)" << std::endl;
+        if ((!options.recordPath.empty() && !simulation->startRecording(options.recordPath)) ||
+            (!options.metricsPath.empty() && !simulation->startMetrics(options.metricsPath))) {
+            return -1;
+        }
+        shown = &simulation->intersections[static_cast<size_t>(options.shownRow) * options.gridColumns + options.shownColumn];
+    }
+    else {
+        replay.emplace(replayLog, geometry, static_cast<std::uint32_t>(options.shownRow * replayLog.header.columns + options.shownColumn));
+        if (!replay->seek(0)) {
+            return -1;
+        }
+    }
+    AgentRenderer agentRenderer(geometry, assets.agents);
+    TrafficLightRenderer lightRenderer;
+    StaticLayer staticLayer;
+    if (!staticLayer.create()) {
+        std::cerr << "Erreur : Impossible de créer la couche statique !" << std::endl;
+        return -1;
+    }
+
+    // La simulation avance sur son propre thread et publie une image du carrefour affiché après
+    // chaque série de pas ; la fenêtre dessine la dernière image complète sans jamais l'attendre.
+    // Le rejeu, qui ne fait avancer qu'une tuile, tourne directement dans la boucle de la fenêtre.
+    SimClock replayClock(replay ? replayLog.header.dt : options.dt);
+    SimClock& simClock = simulation ? simulation->clock : replayClock;
+    TripleBuffer<WorldFrame> frames;
+    WorldFrame replayFrame;
+    std::atomic<bool> running{ true };
+    std::thread simulationThread;
+    if (simulation) {
+        simulationThread = std::thread([&] {
+            auto last = std::chrono::steady_clock::now();
+            while (running.load(std::memory_order_acquire)) {
+                auto now = std::chrono::steady_clock::now();
+                long long steps = simClock.stepsForFrame(std::chrono::duration<float>(now - last).count());
+                last = now;
+                for (long long k = 0; k < steps; ++k) {
+                    simulation->step();
+                }
+                if (steps > 0) {
+                    frames.back().capture(shown->agents, shown->trafficLight.getState(), simClock.time);
+                    frames.publish();
+                }
+
+                // Attend le prochain pas (ou une commande en pause) au lieu de tourner à vide
+                double wait = simClock.isPaused() ? 0.005 : std::clamp(simClock.secondsUntilNextStep(), 0.0, 0.005);
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+            }
+        });
+    }
+
+    // Espace : pause, flèche droite : un pas (en pause), +/- : vitesse x10 / /10, 1 : vitesse réelle.
+    // En rejeu, flèches gauche et droite : recule ou avance de REPLAY_SEEK_SECONDS.
+    const float REPLAY_SEEK_SECONDS = 10;
+    auto lastFrame = std::chrono::steady_clock::now();
+
+    while (window.isOpen()) {
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed) {
+                window.close();
+            }
+            else if (event.type == sf::Event::KeyPressed) {
+                switch (event.key.code) {
+                case sf::Keyboard::Space:
+                    simClock.togglePause();
+                    break;
+                case sf::Keyboard::Left:
+                case sf::Keyboard::Right:
+                    if (replay) {
+                        long long seekTicks = std::llround(REPLAY_SEEK_SECONDS / replayLog.header.dt);
+                        if (!replay->seek(replay->tick + (event.key.code == sf::Keyboard::Left ? -seekTicks : seekTicks))) {
+                            loadFailed = true;
+                            window.close();
+                        }
+                    }
+                    else if (event.key.code == sf::Keyboard::Right) {
+                        simClock.requestSingleStep();
+                    }
+                    break;
+                case sf::Keyboard::Add:
+                case sf::Keyboard::Up:
+                    simClock.setTimeScale(simClock.timeScale() * 10);
+                    break;
+                case sf::Keyboard::Subtract:
+                case sf::Keyboard::Down:
+                    simClock.setTimeScale(simClock.timeScale() / 10);
+                    break;
+                case sf::Keyboard::Num1:
+                    simClock.setTimeScale(1);
+                    break;
+                default:
+                    break;
+                }
+                std::ostringstream title;
+                title << "Traffic Simulation with Background - x" << simClock.timeScale() << (simClock.isPaused() ? " (pause)" : "");
+                if (replay) {
+                    title << " - rejeu t=" << static_cast<long long>(replay->time()) << " s";
+                }
+                window.setTitle(title.str());
+            }
+        }
+
+        if (assetLoader && assetLoader->pending() && !assetLoader->poll(assets)) {
+            loadFailed = true;
+            window.close();
+        }
+        if (!backgroundSprite.getTexture() && assets.background.getSize().x > 0) {
+            backgroundSprite.setTexture(assets.background, true);
+            backgroundSprite.setScale(
+                float(WINDOW_WIDTH) / assets.background.getSize().x,
+                float(WINDOW_HEIGHT) / assets.background.getSize().y
+            );
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (replay) {
+            long long steps = simClock.stepsForFrame(std::chrono::duration<float>(now - lastFrame).count());
+            for (long long k = 0; k < steps && replay->step(); ++k) {
+            }
+            replayFrame.capture(replay->tile.agents, replay->tile.trafficLight.getState(), replay->time());
+        }
+        lastFrame = now;
+
+        const WorldFrame& frame = replay ? replayFrame : frames.read();
+        window.clear();
+        staticLayer.draw(window, backgroundSprite.getTexture() ? &backgroundSprite : nullptr, lightRenderer, frame.lightState);
+        agentRenderer.draw(window, frame);
+        window.display();
+    }
+
+    running.store(false, std::memory_order_release);
+    if (simulationThread.joinable()) {
+        simulationThread.join();
+    }
+
+    return loadFailed ? -1 : 0;
 }